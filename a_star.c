@@ -1,10 +1,108 @@
 #include "tools.h"
-#include "heap.h"
+#include "openlist.h"
+#include "arena.h"
+#include "outbox.h"
+#include "partition.h"
+#include "mailbox.h"
+#include "jump.h"
+#include "landmark.h"
+#include "hpa.h"
+#include "stats.h"
+#include "trace.h"
 #include "string.h"
 #include <mpi.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
 
 #define MAX_NEIGHBORS 8
 #define INIT_HEAP_CAPACITY 4
+#define NODE_CHUNK_SHIFT 16 // search nodes are allocated by chunks of 2^16
+#define FLUSH_DELAY 1e-3    // seconds a generated node may wait in an outgoing buffer
+#define DIAGONAL_TIE 0.01   // added to the score of diagonal moves to prefer straight ones
+
+// Open list implementation and bucket width, set from the command line
+static openlist_kind open_kind = OL_HEAP;
+static double bucket_delta = 0.01;
+
+// Number of nodes aggregated in a message of the MPI engine, set from the command line
+static int batch_size = 64;
+
+// Number of worker threads per process of the hybrid engine, set from the command line
+static int threads = 1;
+
+// Work distribution function of the MPI engine and side of the groups of
+// cells of PART_ABSTRACT, set from the command line
+static partition_kind part_kind = PART_DIAGONAL;
+static int part_side = 8;
+
+// Grid storage, set from the command line: every process stores the whole
+// grid, only its block of -p block plus a border of one cell, or the whole
+// grid with the values shared by the processes of a node
+typedef enum
+{
+    GRID_FULL,
+    GRID_LOCAL,
+    GRID_SHARED,
+} grid_storage;
+static const char *storage_names[] = {"full", "local", "shared"};
+static grid_storage storage = GRID_FULL;
+
+// Whether the sequential and MPI engines search from both ends, set from the command line
+static bool bidirectional = false;
+
+// Jump points of the sequential engine on grids of free cells and walls, set from the command line
+static jump_kind jump_mode = JUMP_SCAN;
+
+// Number of landmarks of the heuristic (0 for the bird's eye view) and file
+// caching their tables, set from the command line
+static int landmark_count = 0;
+static char *landmark_file = NULL;
+
+// Side of the clusters of the hierarchical engine (0 to search the grid
+// itself) and file caching its abstract graph, set from the command line
+static int cluster_side = 0;
+static char *cluster_file = NULL;
+
+// File of the queries of the batch mode (NULL for the single query from
+// the corner to the corner), set from the command line
+static char *query_file = NULL;
+
+// Prefix of the files of the values and the marks of the grid written after
+// the search (NULL for none), set from the command line
+static char *dump_prefix = NULL;
+
+// Number of nodes expanded by the last search, by all the processes, reported by main()
+static long expansions;
+
+// Distribution statistics of the last MPI search, reported by main(): the
+// fraction of the generated nodes sent to another process, the ratio of the
+// maximum to the average number of nodes expanded by a process (a worker
+// thread of the hybrid engine), and the number of messages between processes
+static double send_ratio, load_imbalance;
+static long messages;
+
+// Allocation statistics of the node arena of the last search, reported by main()
+static arena_stats node_stats;
+
+// Counters of the last search of this process, reduced and printed by main()
+// for -S, and whether to print the table, and the nodes sent between the
+// processes
+static search_stats stats;
+static bool stats_table = false, stats_peers = false;
+
+// Timeline of the phases of the search of this process, written to
+// trace_file for -T
+#define TRACE_EVENTS (1 << 18) // last events kept by every process
+enum
+{
+    TRACE_SEND = STATS_PHASES, // messages sent by an expansion
+    TRACE_WAIT,                // waiting for the completion of the sends
+    TRACE_KINDS
+};
+static const char *const trace_names[TRACE_KINDS] = {"receive", "expand", "idle", "path", "send", "wait sends"};
+static char *trace_file = NULL;
+static trace tracer = NULL;
 
 // A heuristic function is a function h() that returns a (double) distance
 // between a start and end position of the grid. The function could also
@@ -27,6 +125,28 @@ double halpha(position s, position t, grid *G)
     return alpha * hvo(s, t, G);
 }
 
+// "Alpha x Landmarks" heuristic for A*: the best lower bound given by the
+// costs from the landmarks, built by main(). Unlike hvo(), it is admissible
+// on any terrain.
+static landmarks alt;
+double hlandmark(position s, position t, grid *G)
+{
+    return alpha * landmark_bound(alt, G, s, t);
+}
+
+// Heuristic of the searches, halpha() or hlandmark()
+static heuristic hbase = halpha;
+
+// Heuristic of the bidirectional searches: half the difference of the
+// estimates towards the target t of the search and from its origin, so that
+// the forward and backward scores of a cell add up to its cost, plus a
+// constant. The searches may then stop as soon as the sum of their lowest
+// scores reaches the cost of the best path through a cell they both reached.
+double hbidir(position s, position t, grid *G)
+{
+    return (hbase(s, t, G) - hbase(s, G->start, G)) / 2;
+}
+
 double weight[] = {
     1.0,   // V_FREE
     -99.9, // V_WALL
@@ -37,40 +157,57 @@ double weight[] = {
     0.1,   // V_TUNNEL
 };
 
-// Function to compare the score of 2 nodes
-int fcmp_nodescore(const void *u, const void *v)
-{
-    const double a = ((struct node *)u)->score;
-    const double b = ((struct node *)v)->score;
-    return (a < b) ? -1 : (a > b);
-}
-
-node createNode(grid G, position p, node parent, heuristic h)
+// A backward search goes from G.end to G.start on the reversed path: it pays
+// the weight of the cell of the parent, which the path enters from p.
+node createNode(arena A, grid G, position p, node parent, heuristic h, bool backward)
 {
-    double diagonal_len = (p.x != parent->pos.x && p.y != parent->pos.y) ? 0.01 : 0.0;
-    node n = malloc(sizeof(struct node));
+    double diagonal_len = (p.x != parent->pos.x && p.y != parent->pos.y) ? DIAGONAL_TIE : 0.0;
+    position entered = backward ? parent->pos : p;
+    node n = arena_alloc(A);
+    if (n == NULL)
+        return NULL;
     n->pos = p;
     n->parent = parent;
-    n->cost = parent->cost + weight[G.value[p.x][p.y]];
+    n->cost = parent->cost + weight[gridValue(&G, entered.x, entered.y)];
     n->score = n->cost + h(n->pos, G.end, &G) + diagonal_len;
     return n;
 }
 
-mpi_node CreateMpiNode(grid G, position p, mpi_node *parent, int parent_rank, int parent_win_i, heuristic h)
+// Returns true if reaching the open node v through u is cheaper than its
+// current path, in which case v is updated to come from u.
+bool relaxNode(grid G, node v, node u, heuristic h, bool backward)
+{
+    position entered = backward ? u->pos : v->pos;
+    double cost = u->cost + weight[gridValue(&G, entered.x, entered.y)];
+    if (cost >= v->cost)
+        return false;
+    double diagonal_len = (v->pos.x != u->pos.x && v->pos.y != u->pos.y) ? DIAGONAL_TIE : 0.0;
+    v->parent = u;
+    v->cost = cost;
+    v->score = cost + h(v->pos, G.end, &G) + diagonal_len;
+    return true;
+}
+
+// Same as createNode(), for the nodes of the MPI engine.
+mpi_node CreateMpiNode(grid G, position p, mpi_node *parent, int parent_rank, int parent_win_i, heuristic h,
+                       bool backward)
 {
     mpi_node n;
-    double diagonal_len = (p.x != parent->pos.x && p.y != parent->pos.y) ? 0.1 : 0.0;
+    double diagonal_len = (p.x != parent->pos.x && p.y != parent->pos.y) ? DIAGONAL_TIE : 0.0;
+    position entered = backward ? parent->pos : p;
     n.pos = p;
-    n.cost = parent->cost + weight[G.value[p.x][p.y]];
+    n.cost = parent->cost + weight[gridValue(&G, entered.x, entered.y)];
     n.score = n.cost + h(p, G.end, &G) + diagonal_len;
     n.parent_rank = parent_rank;
     n.parent_win_i = parent_win_i;
     return n;
 }
 
-mpi_node *mpiNodeToPtr(mpi_node n)
+mpi_node *mpiNodeToPtr(arena A, mpi_node n)
 {
-    mpi_node *n_ptr = malloc(sizeof(mpi_node));
+    mpi_node *n_ptr = arena_alloc(A);
+    if (n_ptr == NULL)
+        return NULL;
     n_ptr->pos = n.pos;
     n_ptr->cost = n.cost;
     n_ptr->score = n.score;
@@ -79,10 +216,171 @@ mpi_node *mpiNodeToPtr(mpi_node n)
     return n_ptr;
 }
 
+// Search structures of the single process engines, kept between the
+// queries of a batch on the same grid (see runBatch()) rather than allocated
+// and released by every search, so that a query only pays for the cells it
+// touches. Only the single process engines run in a batch.
+//
+//  on      = whether a batch is running
+//  Q       = Q[i] is the open list of slot i, with nkeys[i] keys, if stored
+//  node_of = node_of[i] is the array of slot i mapping the cells to the
+//            nodes, of cells[i] entries, if any
+//  A       = node arena, if any
+//  back    = marks of the backward search of A_star_bidirectional(), with
+//            their epoch, if any
+static struct
+{
+    bool on;
+    openlist Q[2];
+    size_t nkeys[2];
+    bool stored[2];
+    int *node_of[2];
+    size_t cells[2];
+    arena A;
+    uint8_t *back;
+    uint8_t back_epoch;
+} kept;
+
+// Returns an empty open list with keys in [0,nkeys[: the one kept in slot i
+// by the previous search of the batch if it has as many keys.
+static openlist startOpenList(int i, size_t nkeys)
+{
+    bool reuse = kept.stored[i] && kept.nkeys[i] == nkeys;
+    if (kept.stored[i] && !reuse)
+        openlist_destroy(kept.Q[i]);
+    kept.stored[i] = false;
+    kept.nkeys[i] = nkeys;
+    return reuse ? kept.Q[i] : openlist_create(open_kind, INIT_HEAP_CAPACITY, nkeys, bucket_delta);
+}
+
+// Releases the open list Q, or keeps it in slot i for the next search of the
+// batch once emptied.
+static void stopOpenList(int i, openlist Q)
+{
+    if (!kept.on)
+    {
+        openlist_destroy(Q);
+        return;
+    }
+    while (!openlist_empty(Q))
+        openlist_pop(Q);
+    kept.Q[i] = Q;
+    kept.stored[i] = true;
+}
+
+// Returns an array of cells entries, only read for the marked cells: the one
+// kept in slot i by the previous search of the batch if it is as large.
+static int *startNodeOf(int i, size_t cells)
+{
+    if (kept.on && kept.node_of[i] != NULL && kept.cells[i] == cells)
+    {
+        int *node_of = kept.node_of[i];
+        kept.node_of[i] = NULL;
+        return node_of;
+    }
+    return malloc(cells * sizeof(int));
+}
+
+// Releases the array node_of of cells entries, or keeps it in slot i for the
+// next search of the batch.
+static void stopNodeOf(int i, int *node_of, size_t cells)
+{
+    if (!kept.on)
+    {
+        free(node_of);
+        return;
+    }
+    free(kept.node_of[i]);
+    kept.node_of[i] = node_of;
+    kept.cells[i] = cells;
+}
+
+// Returns an empty arena of search nodes, the one of the previous search of
+// the batch if any.
+static arena startArena(void)
+{
+    if (kept.on && kept.A != NULL)
+    {
+        arena A = kept.A;
+        kept.A = NULL;
+        return A;
+    }
+    return arena_create(sizeof(struct node), NODE_CHUNK_SHIFT);
+}
+
+// Releases the open list and all the nodes of a search, recording the
+// allocation statistics of the node arena. The single process engines keep
+// them for the next search of a batch.
+static void endSearch(openlist Q, arena A)
+{
+    node_stats = arena_get_stats(A);
+    if (kept.on)
+    {
+        stopOpenList(0, Q);
+        arena_reset(A);
+        kept.A = A;
+        return;
+    }
+    openlist_destroy(Q);
+    arena_destroy(A);
+}
+
+// Frees the structures kept by the searches of a batch, which is over.
+static void endBatch(void)
+{
+    kept.on = false;
+    for (int i = 0; i < 2; i++)
+    {
+        if (kept.stored[i])
+            openlist_destroy(kept.Q[i]);
+        free(kept.node_of[i]);
+    }
+    if (kept.A != NULL)
+        arena_destroy(kept.A);
+    free(kept.back);
+    memset(&kept, 0, sizeof(kept));
+}
+
+// Closed nodes of a process in the order they were expanded. The index of
+// a node in the store is the parent_win_i of the nodes it generates, which
+// allows to follow the path back to the origin.
+typedef struct
+{
+    mpi_node *array;
+    int n, nmax;
+} closed_store;
+
+// Creates an empty closed store that can hold k>0 nodes before growing.
+static closed_store closedCreate(int k)
+{
+    closed_store C = {malloc(k * sizeof(mpi_node)), 0, k};
+    return C;
+}
+
+// Appends node u to the closed store C and returns its index, or -1 if
+// there is not enough memory.
+static int closedAdd(closed_store *C, const mpi_node *u)
+{
+    if (C->n == C->nmax)
+    {
+        int nmax = C->nmax * 2;
+        mpi_node *array = realloc(C->array, nmax * sizeof(mpi_node));
+        if (array == NULL)
+            return -1;
+        C->array = array;
+        C->nmax = nmax;
+    }
+    C->array[C->n] = *u;
+    return C->n++;
+}
+
+// Work distribution function of the MPI engine, built by main()
+static partition part;
+
 // Return the rank number of the core that is going to process the node with position p
-int hda(position p, int world_size)
+static inline int hda(position p)
 {
-    return (p.x + p.y) % world_size;
+    return partition_owner(&part, p);
 }
 
 void CreateMpiPositionDataType(MPI_Datatype *position_dt)
@@ -129,206 +427,540 @@ void CreateMpiNodeDataType(MPI_Datatype *mpi_node_dt, MPI_Datatype mpi_position_
     MPI_Type_commit(mpi_node_dt);
 }
 
-double A_star_mpi(grid G, heuristic h)
+// State of the search of one process of the MPI engine.
+//
+//  G         = grid, whose marks are only meaningful for the cells owned by the process
+//  Q         = open list
+//  A         = nodes of the cells owned by the process, open or closed
+//  node_of   = node_of[k] is the index in A of the node of cell k, if k is marked
+//  C         = closed store
+//  incumbent = cost of the best path to the destination known so far
+//  O         = outgoing nodes, aggregated per destination
+//  pending   = lower bound of the scores of the nodes waiting in O
+//  in        = buffer of incoming nodes, of capacity nin
+//  received  = number of nodes received from the other processes
+//  expanded  = number of nodes expanded
+//  generated = number of nodes generated, remote = how many were sent away
+//  reopened  = number of closed nodes opened again
+//  duplicates = number of nodes dropped for a cell with a path as cheap
+//  open_peak = largest number of nodes in Q
+//  other     = search in the other direction of a bidirectional search, or NULL
+//  met       = cost of the best path through a cell reached by both searches
+//  meet      = that cell
+typedef struct mpi_search
 {
-    int rank, world_size;
-
-    MPI_Comm_size(MPI_COMM_WORLD, &world_size);
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-
-    // Create the datatypes
-    MPI_Datatype mpi_position_dt, mpi_node_dt;
-    CreateMpiPositionDataType(&mpi_position_dt);
-    CreateMpiNodeDataType(&mpi_node_dt, mpi_position_dt);
-
-    int dim = G.X * G.Y;
+    grid G;
+    openlist Q;
+    arena A;
+    int *node_of;
+    closed_store C;
+    double incumbent;
+    outbox O;
+    double pending;
+    mpi_node *in;
+    int nin;
+    long received;
+    long expanded, generated, remote;
+    long reopened, duplicates, open_peak;
+    struct mpi_search *other;
+    double met;
+    position meet;
+} mpi_search;
+
+// Releases everything allocated by the search of a process.
+static void endMpiSearch(mpi_search *S)
+{
+    outbox_destroy(S->O);
+    free(S->in);
+    free(S->C.array);
+    free(S->node_of);
+    endSearch(S->Q, S->A);
+}
 
-    const int ARRAY_SIZE = dim; // TODO: Improve
-    mpi_node window_buffer[ARRAY_SIZE];
-    int cur_win_i = 0;
+// Inserts the node n, generated or received by the process owning its cell,
+// in the open list. If the cell already has a node, it takes the path of n
+// when it is cheaper, and is reopened if it was closed: as the processes do
+// not expand the nodes in the global order of their scores, a cell can be
+// closed before its cheapest path reaches its owner. Nodes that cannot
+// improve the incumbent are dropped, except in a bidirectional search whose
+// scores do not bound the cost of the paths. Returns true if there is not
+// enough memory.
+static bool openMpiNode(mpi_search *S, mpi_node n)
+{
+    grid *G = &S->G;
+    if (S->other == NULL && n.score - DIAGONAL_TIE >= S->incumbent)
+        return false;
 
-    // Create a heap with a capacity of the dimension of the graph
-    heap Q = heap_create(INIT_HEAP_CAPACITY, fcmp_nodescore);
+    int m = gridMark(G, n.pos.x, n.pos.y);
+    size_t k = gridIndex(G, n.pos.x, n.pos.y);
+    int id;
 
-    // Verify if destination is a wall
-    if (G.value[G.end.x][G.end.y] == V_WALL)
+    if (m == M_NULL)
     {
-        fprintf(stderr, "DESTINATION ON WALL\n");
-        heap_destroy(Q);
-        return -1;
+        id = S->A->n;
+        if (mpiNodeToPtr(S->A, n) == NULL)
+            return true;
+        S->node_of[k] = id;
+    }
+    else
+    {
+        id = S->node_of[k];
+        mpi_node *v = arena_get(S->A, id);
+        if (n.cost >= v->cost)
+        {
+            S->duplicates++;
+            return false;
+        }
+        *v = n;
+        S->reopened += m == M_USED;
     }
 
-    int starting_process_rank = hda(G.start, world_size);
-    int ending_process_rank = hda(G.end, world_size);
-
-    // Set tags
-    int destination_reached_tag = 1;
-    int node_tag = 2;
-    int path_construction_tag = 3;
-    int path_done_tag = 4;
+    if (m == M_FRONT)
+    {
+        if (openlist_decrease(S->Q, k, n.score, n.cost))
+            return true;
+    }
+    else
+    {
+        if (openlist_add(S->Q, n.score, n.cost, k, id))
+            return true;
+        setGridMark(G, n.pos.x, n.pos.y, M_FRONT);
+    }
 
-    // Get the node that will process the origin node
-    if (rank == starting_process_rank)
+    // A path through the cell, if the search in the other direction reached
+    // it. The cell has the same owner in both directions.
+    if (S->other != NULL)
     {
-        // Init origin node
-        mpi_node *s = malloc(sizeof(mpi_node));
-        s->pos = G.start;
-        s->cost = 0;
-        s->score = s->cost + h(s->pos, G.end, &G);
-        s->parent_rank = -1;
-        s->parent_win_i = -1;
-        if (heap_add(Q, s)) // add s to heap Q
+        mpi_search *O = S->other;
+        if (gridMark(&O->G, n.pos.x, n.pos.y) != M_NULL)
         {
-            fprintf(stderr, "Heap cannot expand anymore\n");
-            heap_destroy(Q);
-            MPI_Abort(MPI_COMM_WORLD, 1);
+            double cost = n.cost + ((mpi_node *)arena_get(O->A, O->node_of[k]))->cost;
+            if (cost < S->met)
+            {
+                S->met = O->met = cost;
+                S->meet = O->meet = n.pos;
+            }
+            if (cost < S->incumbent)
+                S->incumbent = O->incumbent = cost;
         }
-        G.mark[s->pos.x][s->pos.y] = M_FRONT;
+        return false;
     }
 
-    while (true)
+    // A new path to the destination
+    if (n.pos.x == G->end.x && n.pos.y == G->end.y && n.cost < S->incumbent)
+        S->incumbent = n.cost;
+    return false;
+}
+
+// Receives the messages of nodes waiting for this process and passes every
+// node to deliver(), openMpiNode() or the function of the hybrid engine that
+// hands it to the thread owning it. Returns true if there is not enough memory.
+static bool receiveNodes(mpi_search *S, MPI_Datatype mpi_node_dt, int node_tag,
+                         bool (*deliver)(mpi_search *, mpi_node))
+{
+    MPI_Status status_node;
+    int flag_node;
+
+    // Check if we received a node
+    MPI_Iprobe(MPI_ANY_SOURCE, node_tag, MPI_COMM_WORLD, &flag_node, &status_node);
+
+    // We may have received multiple ones from different sources
+    while (flag_node)
     {
-        do
+        // Get number of nodes received, the buffer grows to the largest message
+        int number_nodes_receiving;
+        MPI_Get_count(&status_node, mpi_node_dt, &number_nodes_receiving);
+        if (number_nodes_receiving > S->nin)
         {
-            int flag_found;
+            mpi_node *buf = realloc(S->in, number_nodes_receiving * sizeof(mpi_node));
+            if (buf == NULL)
+                return true;
+            S->in = buf;
+            S->nin = number_nodes_receiving;
+        }
 
-            // Check if destination has been reached
-            MPI_Iprobe(ending_process_rank, destination_reached_tag, MPI_COMM_WORLD, &flag_found, MPI_STATUS_IGNORE);
-            if (flag_found)
-            {
-                MPI_Recv(NULL, 0, MPI_INT, ending_process_rank, destination_reached_tag, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        MPI_Recv(S->in, number_nodes_receiving, mpi_node_dt, status_node.MPI_SOURCE, status_node.MPI_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        S->received += number_nodes_receiving;
 
-                // Loop until path has been fully constructed
-                while (true)
-                {
-                    // Check path is done
-                    int flag_path_done;
-                    MPI_Iprobe(ending_process_rank, path_done_tag, MPI_COMM_WORLD, &flag_path_done, MPI_STATUS_IGNORE);
-                    if (flag_path_done)
-                    {
-                        MPI_Recv(NULL, 0, MPI_INT, ending_process_rank, path_done_tag, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-                        heap_destroy(Q);
-                        return 1;
-                    }
+        // Add nodes to heap
+        for (int i = 0; i < number_nodes_receiving; i++)
+            if (deliver(S, S->in[i]))
+                return true;
 
-                    // Check if ending process require info about a node
-                    int flag_path;
-                    MPI_Iprobe(ending_process_rank, path_construction_tag, MPI_COMM_WORLD, &flag_path, MPI_STATUS_IGNORE);
-                    if (flag_path)
-                    {
-                        int win_i;
-                        MPI_Recv(&win_i, 1, MPI_INT, ending_process_rank, path_construction_tag, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-                        MPI_Send(&window_buffer[win_i], 1, mpi_node_dt, ending_process_rank, path_construction_tag, MPI_COMM_WORLD);
-                    }
-                }
-            }
+        // Check if we received a node again
+        MPI_Iprobe(MPI_ANY_SOURCE, node_tag, MPI_COMM_WORLD, &flag_node, &status_node);
+    }
+    return false;
+}
 
-            MPI_Status status_node;
-            int flag_node;
+// Termination detection of the MPI engine.
+//
+// The processes repeatedly reduce, with non-blocking collectives, the
+// number of nodes sent and received, whether they did any work since the
+// previous round, the lowest score they could still expand and the best
+// cost of the destination they know. A round started after the previous one
+// completed everywhere, so if no process worked between its two
+// contributions and the counts of sent and received nodes are equal, no node
+// is in flight (Mattern's four counter method). If moreover no process holds
+// a node whose score is below the incumbent, no process can improve it and
+// the incumbent is the optimal cost. Bidirectional searches stop when the
+// sum of the lowest forward and backward scores reaches the incumbent, the
+// backward bound of a forward search alone is 0.
+typedef struct
+{
+    long counts[3];       // nodes sent, nodes received, processes that worked
+    long total_counts[3]; // sums over the processes
+    double bounds[3];     // lowest score left forward and backward, incumbent
+    double min_bounds[3]; // minimums over the processes
+    double known[2];      // min_bounds[0..1] of the last completed round
+    MPI_Request req[2];
+} termination_round;
+
+// Starts a new round with the number of nodes this process sent and received,
+// whether it worked since the previous round, the lowest scores it could
+// still expand forward and backward, and its incumbent.
+static void startRound(termination_round *R, long sent, long received, bool worked,
+                       double bound_f, double bound_b, double incumbent)
+{
+    R->counts[0] = sent;
+    R->counts[1] = received;
+    R->counts[2] = worked;
+    R->bounds[0] = bound_f;
+    R->bounds[1] = bound_b;
+    R->bounds[2] = incumbent;
+
+    MPI_Iallreduce(R->counts, R->total_counts, 3, MPI_LONG, MPI_SUM, MPI_COMM_WORLD, &R->req[0]);
+    MPI_Iallreduce(R->bounds, R->min_bounds, 3, MPI_DOUBLE, MPI_MIN, MPI_COMM_WORLD, &R->req[1]);
+}
 
-            // Check if we received a node
-            MPI_Iprobe(MPI_ANY_SOURCE, node_tag, MPI_COMM_WORLD, &flag_node, &status_node);
+// Passes node n to the outbox of S for process dst.
+static void sendNode(mpi_search *S, int dst, const mpi_node *n)
+{
+    if (S->O->pending == 0)
+        S->pending = INFINITY;
+    if (n->score < S->pending)
+        S->pending = n->score;
+    outbox_push(S->O, dst, n);
+}
 
-            // We may have received multiple ones from different sources
-            while (flag_node)
-            {
-                // Get number of nodes received
-                int number_nodes_receiving;
-                MPI_Get_count(&status_node, mpi_node_dt, &number_nodes_receiving);
+// Lowest score that the search of a process could still expand, including
+// the nodes waiting in the outgoing buffers. These nodes count as sent in
+// the rounds, which cannot complete until they are received.
+static double searchBound(mpi_search *S)
+{
+    double bound = openlist_min_score(S->Q);
+    if (S->O->pending > 0 && S->pending < bound)
+        bound = S->pending;
+    return bound - DIAGONAL_TIE;
+}
 
-                mpi_node nodes[number_nodes_receiving];
-                MPI_Recv(nodes, number_nodes_receiving, mpi_node_dt, status_node.MPI_SOURCE, status_node.MPI_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+// Returns true if the current round has completed, updating the incumbent
+// of this process with the best one of all the processes.
+static bool roundDone(termination_round *R, mpi_search *S)
+{
+    int flag;
+    MPI_Testall(2, R->req, &flag, MPI_STATUSES_IGNORE);
+    if (!flag)
+        return false;
+    if (R->min_bounds[2] < S->incumbent)
+        S->incumbent = R->min_bounds[2];
+    R->known[0] = R->min_bounds[0];
+    R->known[1] = R->min_bounds[1];
+    return true;
+}
 
-                // Add nodes to heap
-                for (int i = 0; i < number_nodes_receiving; i++)
-                {
-                    if (heap_add(Q, mpiNodeToPtr(nodes[i])))
-                    {
-                        fprintf(stderr, "Heap cannot expand anymore\n");
-                        heap_destroy(Q);
-                        MPI_Abort(MPI_COMM_WORLD, 1);
-                    }
-                    G.mark[nodes[i].pos.x][nodes[i].pos.y] = M_FRONT;
-                }
+// Returns true if the completed round detected the end of the search.
+static bool roundTerminates(termination_round *R)
+{
+    return R->total_counts[2] == 0 && R->total_counts[0] == R->total_counts[1] &&
+           R->min_bounds[0] + R->min_bounds[1] >= R->min_bounds[2];
+}
 
-                // Check if we received a node again
-                MPI_Iprobe(MPI_ANY_SOURCE, node_tag, MPI_COMM_WORLD, &flag_node, &status_node);
-            }
-        } while (heap_empty(Q));
+// Releases the D searches of a process of the MPI engine, recording the
+// allocation statistics of all their node arenas.
+static void endMpiSearches(mpi_search *S, int D)
+{
+    arena_stats total = {0, 0, 0};
+    for (int d = 0; d < D; d++)
+    {
+        endMpiSearch(&S[d]);
+        total.objects += node_stats.objects;
+        total.mallocs += node_stats.mallocs;
+        total.bytes += node_stats.bytes;
+    }
+    node_stats = total;
+    if (D == 2)
+        free(S[1].G.mark);
+}
 
-        mpi_node *u = heap_pop(Q); // extract the node with minimum score
+// Starts a new round with the state of the D searches of this process.
+static void startSearchRound(termination_round *R, mpi_search *S, int D, bool worked)
+{
+    long sent = 0, received = 0;
+    double bound[2] = {0, 0};
+    for (int d = 0; d < D; d++)
+    {
+        sent += S[d].O->objects + S[d].O->pending;
+        received += S[d].received;
+        bound[d] = searchBound(&S[d]);
+    }
+    startRound(R, sent, received, worked, bound[0], bound[1], S[0].incumbent);
+}
 
-        // Node already visited ?
-        // TODO: Check if cost lower than actual cost
-        if (G.mark[u->pos.x][u->pos.y] == M_USED)
+// Returns the search of this process that expands next: the one with the
+// lowest score among those whose nodes could still improve the incumbent, or
+// -1 if there is none. A node of a bidirectional search may improve it if its
+// score plus the lowest score left in the other direction at the last round
+// is below the incumbent.
+static int nextSearch(mpi_search *S, int D, termination_round *R)
+{
+    int next = -1;
+    double best = INFINITY;
+    for (int d = 0; d < D; d++)
+    {
+        double score = openlist_min_score(S[d].Q) - DIAGONAL_TIE;
+        double other = D == 2 ? R->known[1 - d] : 0;
+        if (score + other < S[d].incumbent && score < best)
         {
-            continue;
+            best = score;
+            next = d;
         }
+    }
+    return next;
+}
 
-        // Check if we are on the destination position
-        if (rank == ending_process_rank && u->pos.x == G.end.x && u->pos.y == G.end.y)
+// Ends the current phase of the search of this process at time now,
+// recording it in the trace, and starts phase p. Nothing changes if p is the
+// current phase, so that a phase repeated by the loop of the search is a
+// single span.
+static void switchPhaseAt(stats_phase p, double now)
+{
+    if (p == stats.phase || !stats.timed)
+        return;
+    stats_phase ended = stats.phase;
+    double begin = stats.clock;
+    stats_switch(&stats, p, now);
+    if (tracer != NULL)
+        trace_span(tracer, ended, begin, now, 0);
+}
+
+// Same as switchPhaseAt() now.
+static void switchPhase(stats_phase p)
+{
+    if (p != stats.phase && stats.timed)
+        switchPhaseAt(p, MPI_Wtime());
+}
+
+// Stops the clock of the phases of this process, recording the last one.
+static void stopPhases(void)
+{
+    double begin = stats.clock;
+    stats_stop(&stats);
+    if (tracer != NULL && stats.timed)
+        trace_span(tracer, stats.phase, begin, stats.clock, 0);
+}
+
+// Adds the counters of the search S of this process to stats. The largest
+// open list is the one of the busiest search.
+static void addSearchStats(mpi_search *S)
+{
+    stats.expanded += S->expanded;
+    stats.reopened += S->reopened;
+    stats.duplicates += S->duplicates;
+    stats_open(&stats, S->open_peak);
+    stats.received += S->received;
+    if (S->O == NULL)
+        return;
+    stats.sent += S->O->objects;
+    stats.messages += S->O->messages;
+    stats.bytes += S->O->objects * S->O->size;
+    for (int r = 0; r < stats.peers && r < S->O->ndst; r++)
+        stats.peer_sent[r] += S->O->sent[r];
+}
+
+// Marks in G the path from node path of search S back to the root of S,
+// excluded, reading the parents of the other processes in their closed
+// stores, exposed in window win.
+static void drawMpiPath(grid *G, mpi_search *S, mpi_node path, MPI_Win win, MPI_Datatype mpi_node_dt, int rank)
+{
+    while (path.parent_rank != -1)
+    {
+        // Draw the path, on the cells this process stores
+        if (gridHas(G, path.pos.x, path.pos.y))
+            setGridMark(G, path.pos.x, path.pos.y, M_PATH);
+
+        // Get info about parent node. Every hop depends on the previous
+        // one, so the gets cannot be pipelined, but consecutive hops on
+        // this process (frequent with -p block or abstract) cost nothing
+        mpi_node parent;
+        if (path.parent_rank != rank)
         {
-            // Broadcast that destination has been reached
-            MPI_Request req[world_size - 1]; // Minus itself
-            int cur_req = 0;
-            for (int dst = 0; dst < world_size; dst++)
-            {
-                if (dst != rank)
-                    MPI_Isend(NULL, 0, MPI_INT, dst, destination_reached_tag, MPI_COMM_WORLD, &req[cur_req++]);
-            }
-            MPI_Waitall(cur_req, req, MPI_STATUSES_IGNORE);
+            MPI_Get(&parent, 1, mpi_node_dt, path.parent_rank, path.parent_win_i, 1, mpi_node_dt, win);
+            MPI_Win_flush(path.parent_rank, win);
+        }
+        else
+        {
+            parent = S->C.array[path.parent_win_i];
+        }
 
-            // Construct the path
-            mpi_node path = *u;
-            while (path.pos.x != G.start.x && path.pos.y != G.start.y)
-            {
-                // Draw the path
-                G.mark[path.pos.x][path.pos.y] = M_PATH;
+        path = parent;
+    }
+}
 
-                // Get info about parent node
-                mpi_node parent;
-                if (path.parent_rank != rank)
-                {
-                    int win_i = path.parent_win_i;
-                    MPI_Send(&win_i, 1, MPI_INT, path.parent_rank, path_construction_tag, MPI_COMM_WORLD);
-                    MPI_Recv(&parent, 1, mpi_node_dt, path.parent_rank, path_construction_tag, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-                }
-                else
-                {
-                    parent = window_buffer[path.parent_win_i];
-                }
+// Exits when a process of the MPI engine runs out of memory.
+static void mpiOutOfMemory(const char *what)
+{
+    fprintf(stderr, "%s cannot expand anymore\n", what);
+    MPI_Abort(MPI_COMM_WORLD, 1);
+}
 
-                path = parent;
-            }
+// Every process runs a forward search from G.start, and for -s bidir a
+// backward search from G.end, of the cells it owns.
+double A_star_mpi(grid G, heuristic h)
+{
+    int rank, world_size;
 
-            // Broadcast that path has been constructed
-            cur_req = 0;
-            for (int dst = 0; dst < world_size; dst++)
-            {
-                if (dst != rank)
-                    MPI_Isend(NULL, 0, MPI_INT, dst, path_done_tag, MPI_COMM_WORLD, &req[cur_req++]);
-            }
-            MPI_Waitall(cur_req, req, MPI_STATUSES_IGNORE);
+    MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    // Create the datatypes
+    MPI_Datatype mpi_position_dt, mpi_node_dt;
+    CreateMpiPositionDataType(&mpi_position_dt);
+    CreateMpiNodeDataType(&mpi_node_dt, mpi_position_dt);
+
+    // Set tags, the nodes of the backward search use node_tag + 1
+    int node_tag = 2;
+
+    int D = bidirectional ? 2 : 1;
+    mpi_search S[2];
+    for (int d = 0; d < D; d++)
+    {
+        S[d].G = G;
+
+        // Each process closes about 1/world_size of the cells it will reach,
+        // the store starts with a fraction of that and grows on demand
+        long dim = (long)G.X * G.Y;
+        S[d].C = closedCreate(dim / world_size / 16 + 1);
+
+        // Create a heap with a capacity of the dimension of the graph
+        S[d].Q = openlist_create(open_kind, INIT_HEAP_CAPACITY, gridSize(&G), bucket_delta);
+        S[d].A = arena_create(sizeof(mpi_node), NODE_CHUNK_SHIFT);
+        S[d].node_of = malloc(gridSize(&G) * sizeof(int)); // only read for marked cells
+        S[d].incumbent = INFINITY;
+
+        // Outgoing nodes are aggregated per destination, incoming ones are
+        // received in a buffer that grows to the largest message
+        S[d].O = outbox_create(MPI_COMM_WORLD, batch_size, sizeof(mpi_node), mpi_node_dt, node_tag + d);
+        S[d].nin = batch_size;
+        S[d].in = malloc(S[d].nin * sizeof(mpi_node));
+        S[d].received = 0;
+        S[d].expanded = S[d].generated = S[d].remote = 0;
+        S[d].reopened = S[d].duplicates = S[d].open_peak = 0;
+        S[d].other = D == 2 ? &S[1 - d] : NULL;
+        S[d].met = INFINITY;
+    }
+
+    // The backward search goes from the destination to the origin, with its own marks
+    if (D == 2)
+    {
+        S[1].G.start = G.end;
+        S[1].G.end = G.start;
+        S[1].G.mark = aligned_alloc(GRID_ALIGN, gridSize(&G));
+        if (S[1].G.mark == NULL)
+            mpiOutOfMemory("Grid");
+        memset(S[1].G.mark, M_NULL, gridSize(&G));
+    }
+
+    // Verify if destination is a wall, only the processes storing it know
+    int end_wall = gridHas(&G, G.end.x, G.end.y) && gridValue(&G, G.end.x, G.end.y) == V_WALL;
+    MPI_Allreduce(MPI_IN_PLACE, &end_wall, 1, MPI_INT, MPI_LOR, MPI_COMM_WORLD);
+    if (end_wall)
+    {
+        fprintf(stderr, "DESTINATION ON WALL\n");
+        endMpiSearches(S, D);
+        return -1;
+    }
 
-            heap_destroy(Q);
-            return u->cost;
+    // The process owning the origin of a search opens its first node
+    for (int d = 0; d < D; d++)
+    {
+        grid *Gd = &S[d].G;
+        if (rank == hda(Gd->start))
+        {
+            mpi_node s;
+            s.pos = Gd->start;
+            s.cost = 0;
+            s.score = s.cost + h(s.pos, Gd->end, Gd);
+            s.parent_rank = -1;
+            s.parent_win_i = -1;
+            if (openMpiNode(&S[d], s)) // add s to heap Q
+                mpiOutOfMemory("Heap");
         }
+    }
 
-        // Add node to P
-        G.mark[u->pos.x][u->pos.y] = M_USED;
+    termination_round R;
+    R.known[0] = R.known[1] = -INFINITY;
+    bool worked = false; // whether a node was expanded or received since the last round
+    startSearchRound(&R, S, D, worked);
 
-        window_buffer[cur_win_i] = *u;
+    while (true)
+    {
+        // Receive the nodes sent by the other processes. A poll delivering
+        // nothing belongs to the current phase, the receive phase only starts
+        // when nodes arrive
+        double poll = stats.timed ? MPI_Wtime() : 0;
+        bool delivered = false;
+        for (int d = 0; d < D; d++)
+        {
+            long received = S[d].received;
+            if (receiveNodes(&S[d], mpi_node_dt, node_tag + d, openMpiNode))
+                mpiOutOfMemory("Heap");
+            delivered |= S[d].received != received;
+        }
+        worked |= delivered;
+        if (delivered)
+            switchPhaseAt(STATS_RECEIVE, poll);
 
-        // Create a 2D array where the nodes are going to be stored before getting sent
-        mpi_node node_storage[world_size][MAX_NEIGHBORS];
+        // Check the termination round, and start a new one if needed
+        if (roundDone(&R, &S[0]))
+        {
+            S[D - 1].incumbent = S[0].incumbent;
+            if (roundTerminates(&R))
+                break;
+            startSearchRound(&R, S, D, worked);
+            worked = false;
+        }
 
-        // Create an array that counts the nb of nodes to send to each process and initialize it with 0
-        int nb_nodes_per_process[world_size];
-        for (int i = 0; i < world_size; i++)
+        // Nothing left that could improve the incumbent: send all the nodes
+        // generated so far
+        int d = nextSearch(S, D, &R);
+        switchPhase(d < 0 ? STATS_IDLE : STATS_EXPAND);
+        if (d < 0)
         {
-            nb_nodes_per_process[i] = 0;
+            for (int d = 0; d < D; d++)
+                outbox_flush_before(S[d].O, INFINITY);
+            continue;
         }
 
+        mpi_search *F = &S[d];
+        if (openlist_size(F->Q) > F->open_peak)
+            F->open_peak = openlist_size(F->Q);
+        mpi_node *u = arena_get(F->A, openlist_pop(F->Q)); // extract the node with minimum score
+        long sent = F->O->messages;
+        worked = true;
+
+        // Add node to P
+        setGridMark(&F->G, u->pos.x, u->pos.y, M_USED);
+
+        // The destination is not expanded, its path is rebuilt at the end
+        if (u->pos.x == F->G.end.x && u->pos.y == F->G.end.y)
+            continue;
+
+        F->expanded++;
+        int cur_win_i = closedAdd(&F->C, u);
+        if (cur_win_i < 0)
+            mpiOutOfMemory("Closed store");
+
         // For every neighbor of u
         for (int y = -1; y <= 1; y++)
         {
@@ -339,108 +971,716 @@ double A_star_mpi(grid G, heuristic h)
                 p.x = u->pos.x + x;
                 p.y = u->pos.y + y;
 
-                // If node has not been visited yet or is not a wall
-                if (G.mark[p.x][p.y] == M_NULL && G.value[p.x][p.y] != V_WALL)
+                // Only the owner of a cell knows whether it has been visited,
+                // so every neighbor that is not a wall is handed to its owner
+                if ((x != 0 || y != 0) && gridValue(&G, p.x, p.y) != V_WALL)
                 {
                     // Create and add node to tsend it to its destination process
-                    int dst_process = hda(p, world_size);
-                    mpi_node n = CreateMpiNode(G, p, u, rank, cur_win_i, h);
+                    int dst_process = hda(p);
+                    mpi_node n = CreateMpiNode(F->G, p, u, rank, cur_win_i, h, d == 1);
 
+                    // Cannot improve the incumbent
+                    if (D == 1 && n.score - DIAGONAL_TIE >= F->incumbent)
+                        continue;
+
+                    F->generated++;
                     if (dst_process != rank)
                     {
-                        node_storage[dst_process][nb_nodes_per_process[dst_process]++] = n;
+                        F->remote++;
+                        sendNode(F, dst_process, &n);
                     }
-                    else
+                    else if (openMpiNode(F, n))
                     {
-                        if (heap_add(Q, mpiNodeToPtr(n)))
-                        {
-                            fprintf(stderr, "Heap overloaded\n");
-                            heap_destroy(Q);
-                            MPI_Abort(MPI_COMM_WORLD, 1);
-                        }
+                        mpiOutOfMemory("Heap");
                     }
-
-                    G.mark[n.pos.x][n.pos.y] = M_FRONT; // -> Broadcast
                 }
             }
         }
 
-        MPI_Request req[MAX_NEIGHBORS]; // Maximum request = Max neighbors = 8
-        int cur_req = 0;
-        for (int dst = 0; dst < world_size; dst++)
-        {
-            int nb_nodes = nb_nodes_per_process[dst];
-            if (nb_nodes > 0)
-            {
-                MPI_Isend(&(node_storage[dst][0]), nb_nodes, mpi_node_dt, dst, node_tag, MPI_COMM_WORLD, &req[cur_req++]);
-            }
-        }
-        MPI_Waitall(cur_req, req, MPI_STATUSES_IGNORE);
-
-        cur_win_i++;
+        // Send the nodes that waited too long in their buffer
+        outbox_flush_before(F->O, MPI_Wtime() - FLUSH_DELAY);
+        if (tracer != NULL && F->O->messages > sent)
+            trace_instant(tracer, TRACE_SEND, F->O->messages - sent);
     }
+    switchPhase(STATS_PATH);
 
-    // If path not found
-    heap_destroy(Q);
-    return -1;
-}
-
-double A_star_sequential(grid G, heuristic h)
-{
-    heap Q = heap_create(INIT_HEAP_CAPACITY, fcmp_nodescore);
-
-    // Init destination node
-    node t = malloc(sizeof(struct node));
-    t->pos = G.end;
-
-    // Verify if t is a wall
-    if (G.value[t->pos.x][t->pos.y] == V_WALL)
+    // Every node sent has been received, so the sends complete
+    double wait = MPI_Wtime();
+    for (int d = 0; d < D; d++)
     {
-        fprintf(stderr, "DESTINATION ON WALL\n");
-        heap_destroy(Q);
-        return -1;
+        while (!outbox_done(S[d].O))
+            ;
+        addSearchStats(&S[d]);
     }
+    if (tracer != NULL)
+        trace_span(tracer, TRACE_WAIT, wait, MPI_Wtime(), 0);
 
-    // Init origin node
-    node s = malloc(sizeof(struct node));
-    s->pos = G.start;
-    s->parent = NULL;
-    s->cost = 0;
-    s->score = s->cost + h(s->pos, t->pos, &G);
+    // Distribution statistics
+    long counts[4] = {0, 0, 0, 0}, total_counts[4], max_expanded;
+    for (int d = 0; d < D; d++)
+    {
+        counts[0] += S[d].generated;
+        counts[1] += S[d].remote;
+        counts[2] += S[d].O->messages;
+        counts[3] += S[d].expanded;
+    }
+    MPI_Allreduce(counts, total_counts, 4, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(&counts[3], &max_expanded, 1, MPI_LONG, MPI_MAX, MPI_COMM_WORLD);
+    send_ratio = total_counts[0] > 0 ? (double)total_counts[1] / total_counts[0] : 0;
+    load_imbalance = total_counts[3] > 0 ? (double)max_expanded * world_size / total_counts[3] : 1;
+    messages = total_counts[2];
+    expansions = total_counts[3];
 
-    if (heap_add(Q, s)) // add s to heap Q
+    // If path not found
+    double cost = S[0].incumbent;
+    if (cost == INFINITY)
     {
-        fprintf(stderr, "Heap cannot expand anymore\n");
-        heap_destroy(Q);
+        endMpiSearches(S, D);
         return -1;
     }
-    G.mark[s->pos.x][s->pos.y] = M_FRONT;
 
-    while (!heap_empty(Q))
-    {                         // As long as there are nodes in Q
-        node u = heap_pop(Q); // extract the node with minimum score
+    // The path is rebuilt by the process of the destination, or for a
+    // bidirectional search by the process that found the best meeting cell
+    int builder = hda(G.end);
+    position from = G.end;
+    if (D == 2)
+    {
+        struct
+        {
+            double cost;
+            int rank;
+        } best = {S[0].met, rank};
+        MPI_Allreduce(MPI_IN_PLACE, &best, 1, MPI_DOUBLE_INT, MPI_MINLOC, MPI_COMM_WORLD);
+        builder = best.rank;
+        from = S[0].meet;
+    }
 
-        // Noeud already visited ?
-        if (G.mark[u->pos.x][u->pos.y] == M_USED)
-            continue;
+    // The closed stores are exposed in a window per search, from which the
+    // builder reads the parents of the path with one-sided gets: the other
+    // processes have nothing to serve and wait in MPI_Win_free()
+    MPI_Win win[2];
+    for (int d = 0; d < D; d++)
+        MPI_Win_create(S[d].C.array, (MPI_Aint)S[d].C.n * sizeof(mpi_node), sizeof(mpi_node), MPI_INFO_NULL,
+                       MPI_COMM_WORLD, &win[d]);
+
+    if (rank == builder)
+    {
+        // Construct the path, from the cell back to the origin and for a
+        // bidirectional search on to the destination
+        size_t k = gridIndex(&G, from.x, from.y);
+        for (int d = 0; d < D; d++)
+        {
+            MPI_Win_lock_all(MPI_MODE_NOCHECK, win[d]);
+            drawMpiPath(&G, &S[d], *(mpi_node *)arena_get(S[d].A, S[d].node_of[k]), win[d], mpi_node_dt, rank);
+            MPI_Win_unlock_all(win[d]);
+        }
+        if (D == 2 && gridHas(&G, G.end.x, G.end.y))
+            setGridMark(&G, G.end.x, G.end.y, M_PATH);
+    }
+
+    for (int d = 0; d < D; d++)
+        MPI_Win_free(&win[d]);
+
+    endMpiSearches(S, D);
+    return cost;
+}
+
+// The hybrid engine runs several worker threads in each process: thread t of
+// process rank is worker rank * threads + t and owns the cells that the
+// partition gives to it. The threads of a process pass nodes to each other
+// as mails. Only thread 0 calls MPI (MPI_THREAD_FUNNELED): the other threads
+// mail the nodes of other processes to it, and it forwards the nodes it
+// receives to the threads owning them, so the messages between two processes
+// aggregate the nodes of all their threads. A process alone (no mpirun)
+// runs it as a shared-memory engine.
+
+// Contribution of a thread of the hybrid engine to a termination round. As a
+// process of the MPI engine, a thread contributes between two expansions,
+// when it sees that thread 0 started a new round. Once all its threads have
+// contributed, thread 0 contributes their sum to the round of the processes.
+typedef struct
+{
+    _Alignas(64) atomic_int round; // last round the thread contributed to
+    long sent, received;           // nodes it sent and received, mails and messages
+    bool worked;                   // whether it worked since its previous contribution
+    double bound;                  // lowest score it could still expand
+} thread_round;
+
+// State shared by the threads of a process of the hybrid engine.
+//
+//  T         = number of threads
+//  alone     = whether the process is the only one, then it never calls MPI
+//              during the search
+//  boxes     = boxes[t] is the inbox of thread t, boxes[T] holds the nodes
+//              that the other threads send to other processes through thread 0
+//  returns   = returns[t] holds the mails read that thread t allocated
+//  rounds    = rounds[t] is the contribution of thread t to the current round
+//  round     = current round, started by thread 0
+//  stop      = set by thread 0 when the search is over
+//  incumbent = cost of the best path to the destination known by the process
+typedef struct
+{
+    int T;
+    bool alone;
+    inbox *boxes, *returns;
+    thread_round *rounds;
+    atomic_int round;
+    atomic_bool stop;
+    _Atomic double incumbent;
+    heuristic h;
+    MPI_Datatype mpi_node_dt;
+    int node_tag;
+} hybrid_process;
+
+// A worker thread of the hybrid engine.
+//
+//  S        = search of the cells owned by the worker, S.O and S.in are only
+//             used by thread 0, S.node_of and the marks of S.G are shared by
+//             the threads, each one only accessing the cells it owns
+//  P        = state shared by the threads of the process
+//  t        = index of the thread in the process
+//  id       = index of the worker, the parent_rank of the nodes it generates
+//  M        = nodes sent to the other threads, and to thread 0 for the other
+//             processes (destination T)
+//  received = number of nodes read from the mails of the other threads
+//  worked   = whether the thread worked since its last contribution to a round
+typedef struct
+{
+    mpi_search S; // first member, see deliverHybridNode()
+    hybrid_process *P;
+    int t, id;
+    mailbox M;
+    long received;
+    bool worked;
+    pthread_t thread;
+} hybrid_worker;
+
+// Releases everything allocated by the search of a process of the hybrid
+// engine, recording the allocation statistics of all its node arenas.
+static void endHybridSearch(hybrid_process *P, hybrid_worker *W)
+{
+    arena_stats total = {0, 0, 0};
+    for (int t = 0; t < P->T; t++)
+        mailbox_destroy(W[t].M);
+    for (int t = 0; t < P->T; t++)
+    {
+        mpi_search *S = &W[t].S;
+        if (t == 0)
+        {
+            outbox_destroy(S->O);
+            free(S->in);
+        }
+        free(S->C.array);
+        endSearch(S->Q, S->A);
+        total.objects += node_stats.objects;
+        total.mallocs += node_stats.mallocs;
+        total.bytes += node_stats.bytes;
+    }
+    node_stats = total;
+    free(W[0].S.node_of);
+    free(W);
+    free(P->boxes);
+    free(P->returns);
+    free(P->rounds);
+}
+
+// Exits when a thread of the hybrid engine runs out of memory.
+static void hybridOutOfMemory(void)
+{
+    fprintf(stderr, "Heap cannot expand anymore\n");
+    MPI_Abort(MPI_COMM_WORLD, 1);
+}
+
+// Lowers the incumbent of the process to cost, if it is better.
+static void lowerIncumbent(hybrid_process *P, double cost)
+{
+    double current = atomic_load_explicit(&P->incumbent, memory_order_relaxed);
+    while (cost < current && !atomic_compare_exchange_weak_explicit(&P->incumbent, &current, cost,
+                                                                    memory_order_relaxed,
+                                                                    memory_order_relaxed))
+        ;
+}
+
+// Hands node n, received from another process by thread 0, to the thread
+// owning its cell. Returns true if there is not enough memory.
+static bool deliverHybridNode(mpi_search *S, mpi_node n)
+{
+    hybrid_worker *W = (hybrid_worker *)S;
+    int t = hda(n.pos) % W->P->T;
+    if (t == 0)
+        return openMpiNode(S, n);
+    mailbox_push(W->M, t, &n);
+    return false;
+}
+
+// Passes the nodes of the mails waiting in inbox b to openMpiNode(), or for
+// boxes[T] of thread 0 to the outbox of their process. Returns true if there
+// is not enough memory.
+static bool readMails(hybrid_worker *W, inbox *b)
+{
+    mail *l = inbox_take(b);
+    if (l == NULL)
+        return false;
+
+    bool forward = b == &W->P->boxes[W->P->T];
+    for (mail *m = l; m != NULL; m = m->next)
+    {
+        mpi_node *nodes = (mpi_node *)m->data;
+        for (int i = 0; i < m->n; i++)
+        {
+            if (forward)
+                sendNode(&W->S, hda(nodes[i].pos) / W->P->T, &nodes[i]);
+            else if (openMpiNode(&W->S, nodes[i]))
+                return true;
+        }
+        W->received += m->n;
+    }
+    mail_return(W->P->returns, l);
+    W->worked = true;
+    return false;
+}
+
+// Contributes the state of thread W to the current round, unless it already
+// did. The contribution of thread 0 includes the messages of its process.
+static void contributeRound(hybrid_worker *W)
+{
+    hybrid_process *P = W->P;
+    thread_round *r = &P->rounds[W->t];
+    int round = atomic_load_explicit(&P->round, memory_order_acquire);
+    if (atomic_load_explicit(&r->round, memory_order_relaxed) == round)
+        return;
+
+    r->sent = W->M->objects;
+    r->received = W->received;
+    r->worked = W->worked;
+    r->bound = W->M->pending > 0 ? -INFINITY : openlist_min_score(W->S.Q) - DIAGONAL_TIE;
+    if (W->t == 0)
+    {
+        r->sent += W->S.O->objects + W->S.O->pending;
+        r->received += W->S.received;
+        r->bound = fmin(r->bound, searchBound(&W->S));
+    }
+    atomic_store_explicit(&r->round, round, memory_order_release);
+    W->worked = false;
+}
+
+// Thread 0: starts the round of the process once all its threads contributed
+// to the current round of the threads, and when the round of the processes
+// completes, either stops the search or starts a new round of the threads.
+// *reducing tells whether the round of the processes is in progress.
+static void processRound(hybrid_worker *W, termination_round *R, bool *reducing)
+{
+    hybrid_process *P = W->P;
+    int round = atomic_load_explicit(&P->round, memory_order_relaxed);
+    if (!*reducing)
+    {
+        long sent = 0, received = 0;
+        bool worked = false;
+        double bound = INFINITY;
+        for (int t = 0; t < P->T; t++)
+        {
+            thread_round *r = &P->rounds[t];
+            if (atomic_load_explicit(&r->round, memory_order_acquire) != round)
+                return;
+            sent += r->sent;
+            received += r->received;
+            worked |= r->worked;
+            bound = fmin(bound, r->bound);
+        }
+        double incumbent = atomic_load_explicit(&P->incumbent, memory_order_relaxed);
+
+        // A process alone decides at once, with the test of roundTerminates()
+        if (P->alone)
+        {
+            if (!worked && sent == received && bound >= incumbent)
+                atomic_store_explicit(&P->stop, true, memory_order_relaxed);
+            else
+                atomic_store_explicit(&P->round, round + 1, memory_order_release);
+            return;
+        }
+
+        startRound(R, sent, received, worked, bound, 0, incumbent);
+        *reducing = true;
+    }
+    else if (roundDone(R, &W->S))
+    {
+        lowerIncumbent(P, W->S.incumbent);
+        if (roundTerminates(R))
+            atomic_store_explicit(&P->stop, true, memory_order_relaxed);
+        else
+            atomic_store_explicit(&P->round, round + 1, memory_order_release);
+        *reducing = false;
+    }
+}
+
+// Search loop of a worker thread of the hybrid engine, until thread 0 detects
+// the end of the search.
+static void *hybridWorker(void *arg)
+{
+    hybrid_worker *W = arg;
+    hybrid_process *P = W->P;
+    mpi_search *S = &W->S;
+    grid G = S->G;
+    int T = P->T;
+    int rank = W->id / T;
+    termination_round R;
+    bool reducing = false;
+
+    while (!atomic_load_explicit(&P->stop, memory_order_relaxed))
+    {
+        // Nodes from the other threads, and for thread 0 nodes to and from
+        // the other processes
+        if (readMails(W, &P->boxes[W->t]))
+            hybridOutOfMemory();
+        if (W->t == 0 && !P->alone)
+        {
+            long received = S->received;
+            if (readMails(W, &P->boxes[T]) ||
+                receiveNodes(S, P->mpi_node_dt, P->node_tag, deliverHybridNode))
+                hybridOutOfMemory();
+            W->worked |= S->received != received;
+        }
+
+        // Share the incumbent with the other threads
+        double incumbent = atomic_load_explicit(&P->incumbent, memory_order_relaxed);
+        if (S->incumbent < incumbent)
+            lowerIncumbent(P, S->incumbent);
+        else
+            S->incumbent = incumbent;
+
+        contributeRound(W);
+        if (W->t == 0)
+            processRound(W, &R, &reducing);
+
+        // Nothing left that could improve the incumbent: send all the nodes
+        // generated so far, and let the threads that have work run if the
+        // cores are oversubscribed
+        if (openlist_min_score(S->Q) - DIAGONAL_TIE >= S->incumbent)
+        {
+            mailbox_flush_before(W->M, INFINITY);
+            if (W->t == 0)
+                outbox_flush_before(S->O, INFINITY);
+            sched_yield();
+            continue;
+        }
+
+        if (openlist_size(S->Q) > S->open_peak)
+            S->open_peak = openlist_size(S->Q);
+        mpi_node *u = arena_get(S->A, openlist_pop(S->Q)); // extract the node with minimum score
+        W->worked = true;
+        setGridMark(&G, u->pos.x, u->pos.y, M_USED);
+
+        // The destination is not expanded, its path is rebuilt at the end
+        if (u->pos.x == G.end.x && u->pos.y == G.end.y)
+            continue;
+
+        S->expanded++;
+        int cur_win_i = closedAdd(&S->C, u);
+        if (cur_win_i < 0)
+            hybridOutOfMemory();
+
+        for (int y = -1; y <= 1; y++)
+        {
+            for (int x = -1; x <= 1; x++)
+            {
+                position p = {u->pos.x + x, u->pos.y + y};
+                if ((x == 0 && y == 0) || gridValue(&G, p.x, p.y) == V_WALL)
+                    continue;
+
+                int dst_worker = hda(p);
+                mpi_node n = CreateMpiNode(G, p, u, W->id, cur_win_i, P->h, false);
+
+                // Cannot improve the incumbent
+                if (n.score - DIAGONAL_TIE >= S->incumbent)
+                    continue;
+
+                S->generated++;
+                if (dst_worker == W->id)
+                {
+                    if (openMpiNode(S, n))
+                        hybridOutOfMemory();
+                }
+                else if (dst_worker / T == rank)
+                {
+                    mailbox_push(W->M, dst_worker % T, &n);
+                }
+                else
+                {
+                    S->remote++;
+                    if (W->t == 0)
+                        sendNode(S, dst_worker / T, &n);
+                    else
+                        mailbox_push(W->M, T, &n);
+                }
+            }
+        }
+
+        // Send the nodes that waited too long in their mail or buffer
+        mailbox_flush_before(W->M, mailbox_time() - FLUSH_DELAY);
+        if (W->t == 0)
+            outbox_flush_before(S->O, MPI_Wtime() - FLUSH_DELAY);
+    }
+    return NULL;
+}
+
+double A_star_hybrid(grid G, heuristic h)
+{
+    int rank, world_size;
+
+    MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    // Create the datatypes
+    MPI_Datatype mpi_position_dt, mpi_node_dt;
+    CreateMpiPositionDataType(&mpi_position_dt);
+    CreateMpiNodeDataType(&mpi_node_dt, mpi_position_dt);
+
+    int T = threads;
+    hybrid_process P;
+    P.T = T;
+    P.alone = world_size == 1;
+    P.boxes = aligned_alloc(sizeof(inbox), (T + 1) * sizeof(inbox));
+    P.returns = aligned_alloc(sizeof(inbox), T * sizeof(inbox));
+    P.rounds = aligned_alloc(sizeof(thread_round), T * sizeof(thread_round));
+    for (int t = 0; t <= T; t++)
+        atomic_init(&P.boxes[t].head, NULL);
+    for (int t = 0; t < T; t++)
+    {
+        atomic_init(&P.returns[t].head, NULL);
+        atomic_init(&P.rounds[t].round, -1);
+    }
+    atomic_init(&P.round, 0);
+    atomic_init(&P.stop, false);
+    atomic_init(&P.incumbent, INFINITY);
+    P.h = h;
+    P.mpi_node_dt = mpi_node_dt;
+    P.node_tag = 2;
+
+    // Each worker closes about 1/(world_size * T) of the cells it will reach
+    long dim = (long)G.X * G.Y;
+    int *node_of = malloc(gridSize(&G) * sizeof(int)); // only read for marked cells
+    hybrid_worker *W = malloc(T * sizeof(hybrid_worker));
+    for (int t = 0; t < T; t++)
+    {
+        mpi_search *S = &W[t].S;
+        S->G = G;
+        S->Q = openlist_create(open_kind, INIT_HEAP_CAPACITY, gridSize(&G), bucket_delta);
+        S->A = arena_create(sizeof(mpi_node), NODE_CHUNK_SHIFT);
+        S->node_of = node_of;
+        S->C = closedCreate(dim / world_size / T / 16 + 1);
+        S->incumbent = INFINITY;
+        S->O = t == 0 ? outbox_create(MPI_COMM_WORLD, batch_size, sizeof(mpi_node), mpi_node_dt, P.node_tag) : NULL;
+        S->nin = batch_size;
+        S->in = t == 0 ? malloc(S->nin * sizeof(mpi_node)) : NULL;
+        S->received = 0;
+        S->expanded = S->generated = S->remote = 0;
+        S->reopened = S->duplicates = S->open_peak = 0;
+        S->other = NULL;
+        S->met = INFINITY;
+        W[t].P = &P;
+        W[t].t = t;
+        W[t].id = rank * T + t;
+        W[t].M = mailbox_create(T + 1, batch_size, sizeof(mpi_node), P.boxes, P.returns, t);
+        W[t].received = 0;
+        W[t].worked = false;
+    }
+
+    // Verify if destination is a wall, only the processes storing it know
+    int end_wall = gridHas(&G, G.end.x, G.end.y) && gridValue(&G, G.end.x, G.end.y) == V_WALL;
+    MPI_Allreduce(MPI_IN_PLACE, &end_wall, 1, MPI_INT, MPI_LOR, MPI_COMM_WORLD);
+    if (end_wall)
+    {
+        fprintf(stderr, "DESTINATION ON WALL\n");
+        endHybridSearch(&P, W);
+        return -1;
+    }
+
+    int starting_worker = hda(G.start);
+    int ending_worker = hda(G.end);
+
+    if (starting_worker / T == rank)
+    {
+        // Init origin node
+        mpi_node s;
+        s.pos = G.start;
+        s.cost = 0;
+        s.score = s.cost + h(s.pos, G.end, &G);
+        s.parent_rank = -1;
+        s.parent_win_i = -1;
+        if (openMpiNode(&W[starting_worker % T].S, s))
+            hybridOutOfMemory();
+    }
+
+    // This thread is thread 0
+    for (int t = 1; t < T; t++)
+        if (pthread_create(&W[t].thread, NULL, hybridWorker, &W[t]) != 0)
+        {
+            fprintf(stderr, "Cannot create thread %d\n", t);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    hybridWorker(&W[0]);
+    for (int t = 1; t < T; t++)
+        pthread_join(W[t].thread, NULL);
+
+    // Every node sent has been received, so the sends complete
+    while (!outbox_done(W[0].S.O))
+        ;
+    for (int t = 0; t < T; t++)
+        addSearchStats(&W[t].S);
+
+    // Distribution statistics, the imbalance is among the workers
+    long counts[3] = {0, 0, W[0].S.O->messages}, total_counts[3];
+    long expanded[2] = {0, 0}, total_expanded, max_expanded;
+    for (int t = 0; t < T; t++)
+    {
+        counts[0] += W[t].S.generated;
+        counts[1] += W[t].S.remote;
+        expanded[0] += W[t].S.expanded;
+        if (W[t].S.expanded > expanded[1])
+            expanded[1] = W[t].S.expanded;
+    }
+    MPI_Allreduce(counts, total_counts, 3, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(&expanded[0], &total_expanded, 1, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(&expanded[1], &max_expanded, 1, MPI_LONG, MPI_MAX, MPI_COMM_WORLD);
+    send_ratio = total_counts[0] > 0 ? (double)total_counts[1] / total_counts[0] : 0;
+    load_imbalance = total_expanded > 0 ? (double)max_expanded * world_size * T / total_expanded : 1;
+    messages = total_counts[2];
+    expansions = total_expanded;
+
+    // If path not found
+    double cost = atomic_load(&P.incumbent);
+    if (cost == INFINITY)
+    {
+        endHybridSearch(&P, W);
+        return -1;
+    }
+
+    // The closed stores of the threads are attached to a dynamic window, in
+    // which the closed store of worker w starts at address base[w]. A process
+    // alone has all the parents at hand.
+    MPI_Win win = MPI_WIN_NULL;
+    MPI_Aint *base = NULL;
+    if (!P.alone)
+    {
+        MPI_Win_create_dynamic(MPI_INFO_NULL, MPI_COMM_WORLD, &win);
+        base = malloc(world_size * T * sizeof(MPI_Aint));
+        for (int t = 0; t < T; t++)
+        {
+            if (W[t].S.C.n > 0)
+                MPI_Win_attach(win, W[t].S.C.array, (MPI_Aint)W[t].S.C.n * sizeof(mpi_node));
+            MPI_Get_address(W[t].S.C.array, &base[rank * T + t]);
+        }
+        MPI_Allgather(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, base, T, MPI_AINT, MPI_COMM_WORLD);
+    }
+
+    if (ending_worker / T == rank)
+    {
+        if (!P.alone)
+            MPI_Win_lock_all(MPI_MODE_NOCHECK, win);
+
+        // Construct the path, from the node of the destination back to the origin
+        mpi_search *E = &W[ending_worker % T].S;
+        mpi_node path = *(mpi_node *)arena_get(E->A, node_of[gridIndex(&G, G.end.x, G.end.y)]);
+        while (path.parent_rank != -1)
+        {
+            if (gridHas(&G, path.pos.x, path.pos.y))
+                setGridMark(&G, path.pos.x, path.pos.y, M_PATH);
+
+            int w = path.parent_rank;
+            mpi_node parent;
+            if (w / T != rank)
+            {
+                MPI_Aint disp = MPI_Aint_add(base[w], (MPI_Aint)path.parent_win_i * sizeof(mpi_node));
+                MPI_Get(&parent, 1, mpi_node_dt, w / T, disp, 1, mpi_node_dt, win);
+                MPI_Win_flush(w / T, win);
+            }
+            else
+            {
+                parent = W[w % T].S.C.array[path.parent_win_i];
+            }
+
+            path = parent;
+        }
+
+        if (!P.alone)
+            MPI_Win_unlock_all(win);
+    }
+
+    if (!P.alone)
+    {
+        MPI_Barrier(MPI_COMM_WORLD); // the stores stay attached until the path is built
+        for (int t = 0; t < T; t++)
+            if (W[t].S.C.n > 0)
+                MPI_Win_detach(win, W[t].S.C.array);
+        MPI_Win_free(&win);
+        free(base);
+    }
+
+    endHybridSearch(&P, W);
+    return cost;
+}
+
+double A_star_sequential(grid G, heuristic h)
+{
+    expansions = 0;
+    openlist Q = startOpenList(0, gridSize(&G));
+    arena A = startArena();
+
+    // Destination position
+    position t = G.end;
+
+    // Verify if t is a wall
+    if (gridValue(&G, t.x, t.y) == V_WALL)
+    {
+        fprintf(stderr, "DESTINATION ON WALL\n");
+        endSearch(Q, A);
+        return -1;
+    }
+
+    // Init origin node
+    node s = arena_alloc(A);
+    if (s == NULL)
+    {
+        fprintf(stderr, "Heap cannot expand anymore\n");
+        endSearch(Q, A);
+        return -1;
+    }
+    s->pos = G.start;
+    s->parent = NULL;
+    s->cost = 0;
+    s->score = s->cost + h(s->pos, t, &G);
+
+    if (openlist_add(Q, s->score, s->cost, gridIndex(&G, s->pos.x, s->pos.y), 0)) // add s to heap Q
+    {
+        fprintf(stderr, "Heap cannot expand anymore\n");
+        endSearch(Q, A);
+        return -1;
+    }
+    setGridMark(&G, s->pos.x, s->pos.y, M_FRONT);
+
+    while (!openlist_empty(Q))
+    {                         // As long as there are nodes in Q
+        stats_open(&stats, openlist_size(Q));
+        node u = arena_get(A, openlist_pop(Q)); // extract the node with minimum score
 
         // Check if we are on the destination position
-        if (u->pos.x == t->pos.x && u->pos.y == t->pos.y)
+        if (u->pos.x == t.x && u->pos.y == t.y)
         {
-            t = u;
-            node path = t;
+            node path = u;
             while (path != s)
             {
                 // Draw the path
-                G.mark[path->pos.x][path->pos.y] = M_PATH;
+                setGridMark(&G, path->pos.x, path->pos.y, M_PATH);
                 path = path->parent;
             }
-            heap_destroy(Q);
-            return t->cost;
+            double cost = u->cost;
+            endSearch(Q, A);
+            return cost;
         }
 
         // Add node to P
-        G.mark[u->pos.x][u->pos.y] = M_USED;
+        setGridMark(&G, u->pos.x, u->pos.y, M_USED);
+        expansions++;
 
         // For every neighbor of u
         for (int y = -1; y <= 1; y++)
@@ -452,48 +1692,849 @@ double A_star_sequential(grid G, heuristic h)
                 p.x = u->pos.x + x;
                 p.y = u->pos.y + y;
 
-                if (G.mark[p.x][p.y] == M_NULL && G.value[p.x][p.y] != V_WALL)
+                int m = gridMark(&G, p.x, p.y);
+                if (m == M_NULL && gridValue(&G, p.x, p.y) != V_WALL)
                 {
                     // Create and add node to the heap Q
-                    node v = createNode(G, p, u, h);
-                    if (heap_add(Q, v))
+                    int id = A->n;
+                    node v = createNode(A, G, p, u, h, false);
+                    if (v == NULL || openlist_add(Q, v->score, v->cost, gridIndex(&G, p.x, p.y), id))
                     {
                         printf("Heap cannot expand anymore\n");
-                        heap_destroy(Q);
+                        endSearch(Q, A);
                         return -1;
                     };
-                    G.mark[v->pos.x][v->pos.y] = M_FRONT; // -> Broadcast
+                    setGridMark(&G, v->pos.x, v->pos.y, M_FRONT); // -> Broadcast
+                }
+                else if (m == M_FRONT)
+                {
+                    // Lower the cost of the open node if u gives a cheaper path
+                    size_t k = gridIndex(&G, p.x, p.y);
+                    node v = arena_get(A, openlist_get(Q, k));
+                    if (relaxNode(G, v, u, h, false) && openlist_decrease(Q, k, v->score, v->cost))
+                    {
+                        printf("Heap cannot expand anymore\n");
+                        endSearch(Q, A);
+                        return -1;
+                    }
                 }
             }
         }
     }
 
-    heap_destroy(Q);
+    endSearch(Q, A);
     return -1;
 }
 
+// Walls of the grid for the jump point engine, built by main()
+static jump_grid jumps;
+
+// A_star_sequential() generating jump points instead of neighbors, on a grid
+// with only V_FREE and V_WALL cells (see jump.h). A node comes from its parent
+// in a straight or diagonal line of free cells, which the path follows.
+double A_star_jps(grid G, heuristic h)
+{
+    expansions = 0;
+    openlist Q = startOpenList(0, gridSize(&G));
+    arena A = startArena();
+    int *node_of = startNodeOf(0, gridSize(&G)); // only read for marked cells
+
+    // Destination position
+    position t = G.end;
+
+    // Verify if t is a wall
+    if (gridValue(&G, t.x, t.y) == V_WALL)
+    {
+        fprintf(stderr, "DESTINATION ON WALL\n");
+        stopNodeOf(0, node_of, gridSize(&G));
+        endSearch(Q, A);
+        return -1;
+    }
+
+    // Init origin node
+    size_t k = gridIndex(&G, G.start.x, G.start.y);
+    node_of[k] = A->n;
+    node s = arena_alloc(A);
+    if (s == NULL)
+    {
+        fprintf(stderr, "Heap cannot expand anymore\n");
+        stopNodeOf(0, node_of, gridSize(&G));
+        endSearch(Q, A);
+        return -1;
+    }
+    s->pos = G.start;
+    s->parent = NULL;
+    s->cost = 0;
+    s->score = s->cost + h(s->pos, t, &G);
+
+    if (openlist_add(Q, s->score, s->cost, k, node_of[k])) // add s to heap Q
+    {
+        fprintf(stderr, "Heap cannot expand anymore\n");
+        stopNodeOf(0, node_of, gridSize(&G));
+        endSearch(Q, A);
+        return -1;
+    }
+    setGridMark(&G, s->pos.x, s->pos.y, M_FRONT);
+
+    double cost = -1;
+    bool failed = false;
+    while (cost < 0 && !failed && !openlist_empty(Q))
+    {                         // As long as there are nodes in Q
+        stats_open(&stats, openlist_size(Q));
+        node u = arena_get(A, openlist_pop(Q)); // extract the node with minimum score
+
+        // Check if we are on the destination position
+        if (u->pos.x == t.x && u->pos.y == t.y)
+        {
+            // Draw the path, cell by cell between the jump points
+            for (node path = u; path != s; path = path->parent)
+            {
+                position p = path->pos, q = path->parent->pos;
+                int dx = (q.x > p.x) - (q.x < p.x), dy = (q.y > p.y) - (q.y < p.y);
+                for (; p.x != q.x || p.y != q.y; p.x += dx, p.y += dy)
+                    setGridMark(&G, p.x, p.y, M_PATH);
+            }
+            cost = u->cost;
+            continue;
+        }
+
+        // Add node to P
+        setGridMark(&G, u->pos.x, u->pos.y, M_USED);
+        expansions++;
+
+        // Direction of the move that reached u
+        int dx = 0, dy = 0;
+        if (u->parent != NULL)
+        {
+            dx = (u->pos.x > u->parent->pos.x) - (u->pos.x < u->parent->pos.x);
+            dy = (u->pos.y > u->parent->pos.y) - (u->pos.y < u->parent->pos.y);
+        }
+
+        // For every jump point from u
+        int dirs[8];
+        int n = jump_directions(jumps, u->pos.x, u->pos.y, dx, dy, dirs);
+        for (int i = 0; i < n && !failed; i++)
+        {
+            int d = dirs[i];
+            int moves = jump(jumps, u->pos.x, u->pos.y, d, t);
+            if (moves == 0)
+                continue;
+
+            // Calculate position of the node
+            position p;
+            p.x = u->pos.x + moves * jump_dx[d];
+            p.y = u->pos.y + moves * jump_dy[d];
+            size_t k = gridIndex(&G, p.x, p.y);
+            double c = u->cost + moves * weight[V_FREE];
+            double score = c + h(p, t, &G) + (jump_dx[d] != 0 && jump_dy[d] != 0 ? DIAGONAL_TIE : 0.0);
+
+            int m = gridMark(&G, p.x, p.y);
+            if (m == M_NULL)
+            {
+                // Create and add node to the heap Q
+                node_of[k] = A->n;
+                node v = arena_alloc(A);
+                if (v == NULL || openlist_add(Q, score, c, k, node_of[k]))
+                {
+                    fprintf(stderr, "Heap cannot expand anymore\n");
+                    failed = true;
+                    continue;
+                }
+                v->pos = p;
+                v->parent = u;
+                v->cost = c;
+                v->score = score;
+                setGridMark(&G, p.x, p.y, M_FRONT);
+            }
+            else if (m == M_FRONT && c < ((node)arena_get(A, node_of[k]))->cost)
+            {
+                // Lower the cost of the open node, u gives a cheaper path
+                node v = arena_get(A, node_of[k]);
+                v->parent = u;
+                v->cost = c;
+                v->score = score;
+                if (openlist_decrease(Q, k, score, c))
+                {
+                    fprintf(stderr, "Heap cannot expand anymore\n");
+                    failed = true;
+                }
+            }
+        }
+    }
+
+    stopNodeOf(0, node_of, gridSize(&G));
+    endSearch(Q, A);
+    return failed ? -1 : cost;
+}
+
+// Abstract graph of the hierarchical engine, built by main()
+static cluster_graph clusters;
+
+// Search of the abstract graph of the hierarchical engine (see hpa.h), whose
+// nodes are the ones of clusters, then the origin and the destination.
+//
+//  G           = grid searched
+//  h           = heuristic
+//  Q           = open list, whose keys are the abstract nodes
+//  A           = nodes of the search
+//  node_of     = node_of[i] is the index in A of the node of abstract node i,
+//                if it is marked
+//  abstract_of = abstract_of[k] is the abstract node of the node k of A
+//  mark        = mark[i] is the mark of abstract node i, as in a grid
+//  from, to    = searches from the origin and the destination inside their
+//                clusters, whose costs link them to the abstract graph
+typedef struct
+{
+    grid *G;
+    heuristic h;
+    openlist Q;
+    arena A;
+    int *node_of, *abstract_of;
+    uint8_t *mark;
+    hpa_search from, to;
+} abstract_search;
+
+// Cell of abstract node i.
+static position abstractCell(abstract_search *S, int i)
+{
+    return i < clusters->n ? clusters->at[i] : i == clusters->n ? S->G->start : S->G->end;
+}
+
+// Reaches abstract node i from the node u, expanded, by a move of cost
+// cost: opens it, or lowers its cost if it is open. Returns true if there is
+// not enough memory.
+static bool reachAbstract(abstract_search *S, int i, node u, double cost)
+{
+    position p = abstractCell(S, i);
+    cost += u->cost;
+    if (S->mark[i] == M_NULL)
+    {
+        int id = S->A->n;
+        node v = arena_alloc(S->A);
+        if (v == NULL)
+            return true;
+        v->pos = p;
+        v->parent = u;
+        v->cost = cost;
+        v->score = cost + S->h(p, S->G->end, S->G);
+        S->node_of[i] = id;
+        S->abstract_of[id] = i;
+        S->mark[i] = M_FRONT;
+        return openlist_add(S->Q, v->score, v->cost, i, id);
+    }
+    node v = arena_get(S->A, S->node_of[i]);
+    if (S->mark[i] != M_FRONT || cost >= v->cost)
+        return false;
+    v->parent = u;
+    v->cost = cost;
+    v->score = cost + S->h(p, S->G->end, S->G);
+    return openlist_decrease(S->Q, i, v->score, v->cost);
+}
+
+// Hierarchical engine: A* on the abstract graph of the clusters, with the
+// origin and the destination linked to the nodes of their clusters, then
+// the path is refined inside the clusters it crosses. Every process answers
+// the query, which costs far less than building the graph, and only the
+// first one counts its nodes.
+double A_star_hpa(grid G, heuristic h)
+{
+    expansions = 0;
+    cluster_graph H = clusters;
+    int o = H->n, d = H->n + 1; // abstract nodes of the origin and the destination
+
+    // Destination position
+    position t = G.end;
+
+    // Verify if t is a wall
+    if (gridValue(&G, t.x, t.y) == V_WALL)
+    {
+        fprintf(stderr, "DESTINATION ON WALL\n");
+        return -1;
+    }
+
+    abstract_search S;
+    S.G = &G;
+    S.h = h;
+    S.Q = startOpenList(0, H->n + 2);
+    S.A = startArena();
+    S.node_of = malloc((H->n + 2) * sizeof(int));
+    S.abstract_of = malloc((H->n + 2) * sizeof(int));
+    S.mark = malloc(H->n + 2);
+    S.from = hpa_search_create(H, &G, weight);
+    S.to = hpa_search_create(H, &G, weight);
+    hpa_search R = hpa_search_create(H, &G, weight); // refinement of the path
+
+    bool failed = S.node_of == NULL || S.abstract_of == NULL || S.mark == NULL || S.from == NULL || S.to == NULL ||
+                  R == NULL;
+    if (!failed)
+    {
+        memset(S.mark, M_NULL, H->n + 2);
+        long from = hpa_search_from(S.from, G.start), to = hpa_search_from(S.to, t);
+        failed = from < 0 || to < 0;
+        expansions += from + to;
+    }
+
+    // Init origin node
+    node s = arena_alloc(S.A);
+    failed = failed || s == NULL;
+    if (!failed)
+    {
+        s->pos = G.start;
+        s->parent = NULL;
+        s->cost = 0;
+        s->score = s->cost + h(s->pos, t, &G);
+        S.node_of[o] = 0;
+        S.abstract_of[0] = o;
+        S.mark[o] = M_FRONT;
+        failed = openlist_add(S.Q, s->score, s->cost, o, 0);
+    }
+
+    double cost = -1;
+    while (cost < 0 && !failed && !openlist_empty(S.Q))
+    {
+        stats_open(&stats, openlist_size(S.Q));
+        int k = openlist_pop(S.Q);
+        node u = arena_get(S.A, k);
+        int i = S.abstract_of[k];
+
+        // Check if we are on the destination, then refine the path
+        if (i == d)
+        {
+            for (node v = u; v != s && !failed; v = v->parent)
+            {
+                node w = v->parent;
+                if (w == s)
+                {
+                    hpa_search_path(S.from, &G, v->pos);
+                }
+                else if (hpa_cluster(H, w->pos) != hpa_cluster(H, v->pos))
+                {
+                    setGridMark(&G, v->pos.x, v->pos.y, M_PATH);
+                }
+                else
+                {
+                    long e = hpa_search_from(R, w->pos);
+                    failed = e < 0;
+                    expansions += e;
+                    hpa_search_path(R, &G, v->pos);
+                }
+            }
+            cost = u->cost;
+            continue;
+        }
+
+        S.mark[i] = M_USED;
+        expansions++;
+
+        if (i == o)
+        {
+            // The nodes of the cluster of the origin, and the destination if it is there
+            int c = hpa_cluster(H, G.start);
+            for (int j = H->first[c]; j < H->first[c + 1] && !failed; j++)
+                if (hpa_search_cost(S.from, H->at[j]) < INFINITY)
+                    failed = reachAbstract(&S, j, u, hpa_search_cost(S.from, H->at[j]));
+            if (hpa_search_cost(S.from, t) < INFINITY && !failed)
+                failed = reachAbstract(&S, d, u, hpa_search_cost(S.from, t));
+            continue;
+        }
+
+        // The other nodes of the cluster of u
+        int c = hpa_cluster(H, u->pos);
+        int m = H->first[c + 1] - H->first[c];
+        const double *intra = H->intra + H->offset[c] + (long)(i - H->first[c]) * m;
+        for (int b = 0; b < m && !failed; b++)
+            if (H->first[c] + b != i && intra[b] < INFINITY)
+                failed = reachAbstract(&S, H->first[c] + b, u, intra[b]);
+
+        // The nodes across the borders
+        for (int l = H->link_first[i]; l < H->link_first[i + 1] && !failed; l++)
+        {
+            position p = H->at[H->link[l]];
+            failed = reachAbstract(&S, H->link[l], u, weight[gridValue(&G, p.x, p.y)]);
+        }
+
+        // The destination, if it is in the cluster of u: the cost of the
+        // reversed path pays the weight of t instead of the one of u
+        double back = hpa_search_cost(S.to, u->pos);
+        if (back < INFINITY && !failed)
+            failed = reachAbstract(&S, d, u,
+                                   back + weight[gridValue(&G, t.x, t.y)] - weight[gridValue(&G, u->pos.x, u->pos.y)]);
+    }
+    if (failed)
+        fprintf(stderr, "Not enough memory for the abstract search\n");
+
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    free(S.node_of);
+    free(S.abstract_of);
+    free(S.mark);
+    if (S.from != NULL)
+        hpa_search_destroy(S.from);
+    if (S.to != NULL)
+        hpa_search_destroy(S.to);
+    if (R != NULL)
+        hpa_search_destroy(R);
+    endSearch(S.Q, S.A);
+    if (rank != 0)
+        node_stats = (arena_stats){0};
+    return failed ? -1 : cost;
+}
+
+// Bidirectional version of A_star_sequential(): a forward search from
+// G.start and a backward search from G.end, on views of G with their own
+// marks, expand in turn the side whose lowest score is the smallest. Every
+// time a search labels a cell the other one has reached, the path through
+// this cell becomes a candidate. With the scores of hbidir(), the searches
+// stop once the sum of their lowest scores reaches the cheapest candidate.
+double A_star_bidirectional(grid G, heuristic h)
+{
+    expansions = 0;
+    openlist Q[2];
+    int *node_of[2]; // node_of[d][k] is the index in A of the node of cell k in search d, if k is marked
+    grid V[2] = {G, G};
+    arena A = startArena();
+    for (int d = 0; d < 2; d++)
+    {
+        Q[d] = startOpenList(d, gridSize(&G));
+        node_of[d] = startNodeOf(d, gridSize(&G));
+    }
+
+    // The backward search goes from the destination to the origin, with its
+    // own marks, kept with their epoch between the searches of a batch
+    V[1].start = G.end;
+    V[1].end = G.start;
+    if (kept.back != NULL)
+    {
+        V[1].mark = kept.back;
+        V[1].epoch = kept.back_epoch;
+        clearGridMarks(&V[1]);
+        kept.back = NULL;
+    }
+    else
+    {
+        V[1].mark = aligned_alloc(GRID_ALIGN, gridSize(&G));
+        V[1].epoch = MARK_FIRST_EPOCH;
+        memset(V[1].mark, M_NULL, gridSize(&G));
+    }
+
+    double mu = INFINITY; // cost of the cheapest path found so far
+    position meet = G.start;
+    bool failed = false;
+
+    // Verify if t is a wall
+    if (gridValue(&G, G.end.x, G.end.y) == V_WALL)
+    {
+        fprintf(stderr, "DESTINATION ON WALL\n");
+        failed = true;
+    }
+
+    // Init origin nodes
+    for (int d = 0; d < 2 && !failed; d++)
+    {
+        size_t k = gridIndex(&G, V[d].start.x, V[d].start.y);
+        node_of[d][k] = A->n;
+        node s = arena_alloc(A);
+        if (s == NULL)
+        {
+            fprintf(stderr, "Heap cannot expand anymore\n");
+            failed = true;
+            break;
+        }
+        s->pos = V[d].start;
+        s->parent = NULL;
+        s->cost = 0;
+        s->score = s->cost + h(s->pos, V[d].end, &V[d]);
+        if (openlist_add(Q[d], s->score, s->cost, k, node_of[d][k])) // add s to heap Q
+        {
+            fprintf(stderr, "Heap cannot expand anymore\n");
+            failed = true;
+        }
+        setGridMark(&V[d], s->pos.x, s->pos.y, M_FRONT);
+    }
+
+    // A search that runs out of nodes has met the other one wherever it could
+    while (!failed && !openlist_empty(Q[0]) && !openlist_empty(Q[1]))
+    {
+        double top[2];
+        for (int d = 0; d < 2; d++)
+            top[d] = openlist_min_score(Q[d]) - DIAGONAL_TIE;
+        if (top[0] + top[1] >= mu)
+            break;
+
+        int d = top[0] <= top[1] ? 0 : 1, o = 1 - d;
+        grid *F = &V[d];
+        stats_open(&stats, openlist_size(Q[d]));
+        node u = arena_get(A, openlist_pop(Q[d])); // extract the node with minimum score
+
+        // Add node to P
+        setGridMark(F, u->pos.x, u->pos.y, M_USED);
+        expansions++;
+
+        // For every neighbor of u
+        for (int y = -1; y <= 1 && !failed; y++)
+        {
+            for (int x = -1; x <= 1; x++)
+            {
+                // Calculate position of the node
+                position p;
+                p.x = u->pos.x + x;
+                p.y = u->pos.y + y;
+
+                size_t k = gridIndex(&G, p.x, p.y);
+                int m = gridMark(F, p.x, p.y);
+                node v;
+                if (m == M_NULL && gridValue(&G, p.x, p.y) != V_WALL)
+                {
+                    // Create and add node to the heap Q
+                    node_of[d][k] = A->n;
+                    v = createNode(A, *F, p, u, h, d == 1);
+                    if (v == NULL || openlist_add(Q[d], v->score, v->cost, k, node_of[d][k]))
+                    {
+                        fprintf(stderr, "Heap cannot expand anymore\n");
+                        failed = true;
+                        break;
+                    }
+                    setGridMark(F, p.x, p.y, M_FRONT);
+                }
+                else if (m == M_FRONT)
+                {
+                    // Lower the cost of the open node if u gives a cheaper path
+                    v = arena_get(A, node_of[d][k]);
+                    if (!relaxNode(*F, v, u, h, d == 1))
+                        continue;
+                    if (openlist_decrease(Q[d], k, v->score, v->cost))
+                    {
+                        fprintf(stderr, "Heap cannot expand anymore\n");
+                        failed = true;
+                        break;
+                    }
+                }
+                else
+                {
+                    continue;
+                }
+
+                // The other search reached p: a path goes through it
+                if (gridMark(&V[o], p.x, p.y) != M_NULL)
+                {
+                    node w = arena_get(A, node_of[o][k]);
+                    if (v->cost + w->cost < mu)
+                    {
+                        mu = v->cost + w->cost;
+                        meet = p;
+                    }
+                }
+            }
+        }
+    }
+
+    if (!failed && mu < INFINITY)
+    {
+        // Draw the path: from the meeting cell back to the origin, excluded,
+        // then from the meeting cell on to the destination
+        size_t k = gridIndex(&G, meet.x, meet.y);
+        for (node path = arena_get(A, node_of[0][k]); path->parent != NULL; path = path->parent)
+            setGridMark(&G, path->pos.x, path->pos.y, M_PATH);
+        for (node path = ((node)arena_get(A, node_of[1][k]))->parent; path != NULL; path = path->parent)
+            setGridMark(&G, path->pos.x, path->pos.y, M_PATH);
+    }
+
+    if (kept.on)
+    {
+        kept.back = V[1].mark;
+        kept.back_epoch = V[1].epoch;
+    }
+    else
+        free(V[1].mark);
+    for (int d = 0; d < 2; d++)
+        stopNodeOf(d, node_of[d], gridSize(&G));
+    stopOpenList(1, Q[1]);
+    endSearch(Q[0], A);
+    return failed || mu == INFINITY ? -1 : mu;
+}
+
+// Returns the latency of rank r / n of the sorted latencies t[0..n[ (nearest rank).
+static double percentile(const double *t, int n, double r)
+{
+    int i = (int)ceil(r * n) - 1;
+    return t[i < 0 ? 0 : i];
+}
+
+static int compareDoubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Batch mode: answers the queries of file, one "sx sy tx ty" per line, on
+// the grid G with the single process engine f and heuristic h. The grid and
+// what was built for it stay in memory, and so do the search structures
+// between the queries, whose marks are cleared by a new epoch. Query q is
+// answered by process q % size, then the first process prints the cost of
+// every query, the percentiles of their latencies and the throughput of the
+// batch. generation is the time spent generating or reading the grid, build
+// the time spent building the landmarks, jump points or clusters. Returns
+// false if the file cannot be read.
+static bool runBatch(grid G, double (*f)(grid, heuristic), heuristic h, const char *file, double generation,
+                     double build, int rank, int size)
+{
+    FILE *in = fopen(file, "r");
+    if (in == NULL)
+    {
+        if (rank == 0)
+            fprintf(stderr, "Cannot read the queries from %s\n", file);
+        return false;
+    }
+    int n = 0, nmax = 1024;
+    position(*query)[2] = malloc(nmax * sizeof(*query));
+    while (query != NULL &&
+           fscanf(in, "%d %d %d %d", &query[n][0].x, &query[n][0].y, &query[n][1].x, &query[n][1].y) == 4)
+    {
+        if (++n == nmax)
+        {
+            nmax *= 2;
+            position(*more)[2] = realloc(query, nmax * sizeof(*query));
+            if (more == NULL)
+                free(query);
+            query = more;
+        }
+    }
+    fclose(in);
+    if (query == NULL)
+    {
+        if (rank == 0)
+            fprintf(stderr, "Not enough memory for the queries of %s\n", file);
+        return false;
+    }
+
+    // Every query is answered by one process, the others leave 0 for the sums.
+    // The cost is -1 without a path, -2 for ends out of the grid or on a wall,
+    // which are not searched so that the engines do not warn about them
+    double *cost = calloc(n, sizeof(double)), *latency = calloc(n, sizeof(double));
+    long *expanded = calloc(n, sizeof(long));
+    kept.on = true;
+    MPI_Barrier(MPI_COMM_WORLD);
+    double elapsed = MPI_Wtime();
+    for (int q = rank; q < n; q += size)
+    {
+        position s = query[q][0], t = query[q][1];
+        if (s.x < 0 || s.y < 0 || s.x >= G.X || s.y >= G.Y || t.x < 0 || t.y < 0 || t.x >= G.X || t.y >= G.Y ||
+            gridValue(&G, s.x, s.y) == V_WALL || gridValue(&G, t.x, t.y) == V_WALL)
+        {
+            cost[q] = -2;
+            continue;
+        }
+        G.start = s;
+        G.end = t;
+        clearGridMarks(&G);
+        double start = MPI_Wtime();
+        cost[q] = f(G, h);
+        latency[q] = MPI_Wtime() - start;
+        expanded[q] = expansions;
+    }
+    elapsed = MPI_Wtime() - elapsed;
+    endBatch();
+
+    double wall;
+    MPI_Reduce(&elapsed, &wall, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(rank == 0 ? MPI_IN_PLACE : cost, cost, n, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(rank == 0 ? MPI_IN_PLACE : latency, latency, n, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(rank == 0 ? MPI_IN_PLACE : expanded, expanded, n, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+
+    if (rank == 0)
+    {
+        // The latencies and the throughput are the ones of the queries answered
+        int found = 0;
+        for (int q = 0; q < n; q++)
+        {
+            if (cost[q] < 0)
+                printf("Query %d: (%d,%d) -> (%d,%d)\t%s\n", q, query[q][0].x, query[q][0].y, query[q][1].x,
+                       query[q][1].y, cost[q] < -1 ? "end out of the grid or on a wall" : "path not found");
+            else
+            {
+                printf("Query %d: (%d,%d) -> (%d,%d)\tCost: %g\tPerf: %lgs\tExpanded: %ld\n", q, query[q][0].x,
+                       query[q][0].y, query[q][1].x, query[q][1].y, cost[q], latency[q], expanded[q]);
+                latency[found++] = latency[q];
+            }
+        }
+        qsort(latency, found, sizeof(double), compareDoubles);
+        printf("Batch: %d queries\tFound: %d\tNot found: %d\tNb_cores: %d\tGeneration: %lgs\tBuild: %lgs\tTime: "
+               "%lgs\tThroughput: %lg queries/s\n",
+               n, found, n - found, size, generation, build, wall, found / wall);
+        if (found > 0)
+            printf("Latency: p50 %lgs\tp90 %lgs\tp99 %lgs\tmax %lgs\n", percentile(latency, found, 0.5),
+                   percentile(latency, found, 0.9), percentile(latency, found, 0.99), latency[found - 1]);
+    }
+    free(query);
+    free(cost);
+    free(latency);
+    free(expanded);
+    return true;
+}
+
+// Prints how to run the program.
+static void usage(void)
+{
+    fprintf(stderr, "Usage: ./a_star <seed> <grid width> <grid height> <grid type [empty|walls|maze|<grid file>])> "
+                    "<algorithm [0 (Djikstra)|1 (AStar)|2 (Approx)]> [options]\n"
+                    "Options:\n"
+                    "  -q <heap|bucket>  open list implementation (default: heap)\n"
+                    "  -d <width>        bucket width of the bucket open list (default: 0.01)\n"
+                    "  -B <nodes>        nodes aggregated in a message of the MPI engine (default: 64)\n"
+                    "  -p <diag|zobrist|block|abstract>\n"
+                    "                    work distribution of the MPI engine (default: diag)\n"
+                    "  -A <cells>        side of the groups of cells of -p abstract (default: 8)\n"
+                    "  -t <threads>      worker threads per process, runs without mpirun (default: 1)\n"
+                    "  -g <full|local|shared>\n"
+                    "                    grid stored by each process: the whole grid, its block of\n"
+                    "                    -p block (any type, grid files without tiles), or the\n"
+                    "                    whole grid with one copy of the values per node\n"
+                    "                    (default: full)\n"
+                    "  -s <forward|bidir>\n"
+                    "                    search from the origin only, or from both ends at once\n"
+                    "                    (default: forward, bidir needs -t 1)\n"
+                    "  -j <off|jps|plus> jump point search of the sequential engine on grids of free\n"
+                    "                    cells and walls: off, scanning the walls, or with the jump\n"
+                    "                    distances precomputed (default: jps)\n"
+                    "  -L <landmarks>    landmark heuristic with this number of landmarks, on the\n"
+                    "                    whole grid only (default: 0, bird's eye view)\n"
+                    "  -C <file>         file caching the tables of the landmarks of the grid\n"
+                    "  -H <cells>        hierarchical search (HPA*) on clusters of this side, near\n"
+                    "                    optimal, on the whole grid only (default: 0, off)\n"
+                    "  -c <file>         file caching the abstract graph of the clusters of the grid\n"
+                    "  -Q <file>         batch of queries, one \"sx sy tx ty\" per line, shared by the\n"
+                    "                    processes, each one searching alone, on the whole grid only\n"
+                    "  -o <prefix>       writes the values and the marks of all the processes to\n"
+                    "                    <prefix>.values and <prefix>.marks after the search\n"
+                    "  -S <table|peers>  prints the min/avg/max of the counters of the processes,\n"
+                    "                    and for peers the nodes sent between every two of them\n"
+                    "  -T <file>         writes the timeline of the phases of every process to this\n"
+                    "                    Chrome trace (JSON), for chrome://tracing or Perfetto\n");
+}
+
+// Frees the grid G and everything built for it, then leaves MPI.
+static void releaseAll(grid G, MPI_Comm *node_comm)
+{
+    if (jumps != NULL)
+        jump_destroy(jumps);
+    if (alt != NULL)
+        landmark_destroy(alt);
+    if (clusters != NULL)
+        hpa_destroy(clusters);
+    partition_destroy(part);
+    stats_free(&stats);
+    if (tracer != NULL)
+        trace_destroy(tracer);
+    freeGrid(G);
+    MPI_Comm_free(node_comm);
+    MPI_Finalize();
+}
+
 int main(int argc, char *argv[])
 {
 
-    if (argc < 2 || argc > 6)
+    if (argc < 6)
     {
-        fprintf(stderr, "Number of arguments should be 5\n"
-                        "Usage: ./a_star <seed> <grid width> <grid height> <grid type [empty|walls|maze])> "
-                        "<algorithm [0 (Djikstra)|1 (AStar)|2 (Approx)]>");
+        fprintf(stderr, "Number of arguments should be at least 5\n");
+        usage();
         return 1;
     }
 
-    MPI_Init(NULL, NULL);
+    // Optional arguments, each one is followed by its value
+    for (int i = 6; i < argc; i += 2)
+    {
+        if (i + 1 >= argc)
+        {
+            fprintf(stderr, "Missing value for option %s\n", argv[i]);
+            usage();
+            return 1;
+        }
+        char *value = argv[i + 1];
+        if (strcmp(argv[i], "-q") == 0 && strcmp(value, "heap") == 0)
+            open_kind = OL_HEAP;
+        else if (strcmp(argv[i], "-q") == 0 && strcmp(value, "bucket") == 0)
+            open_kind = OL_BUCKET;
+        else if (strcmp(argv[i], "-d") == 0 && atof(value) > 0)
+            bucket_delta = atof(value);
+        else if (strcmp(argv[i], "-B") == 0 && atoi(value) > 0)
+            batch_size = atoi(value);
+        else if (strcmp(argv[i], "-p") == 0 && partition_parse(value, &part_kind))
+            ;
+        else if (strcmp(argv[i], "-A") == 0 && atoi(value) > 0)
+            part_side = atoi(value);
+        else if (strcmp(argv[i], "-t") == 0 && atoi(value) > 0)
+            threads = atoi(value);
+        else if (strcmp(argv[i], "-g") == 0 && strcmp(value, "full") == 0)
+            storage = GRID_FULL;
+        else if (strcmp(argv[i], "-g") == 0 && strcmp(value, "local") == 0)
+            storage = GRID_LOCAL;
+        else if (strcmp(argv[i], "-g") == 0 && strcmp(value, "shared") == 0)
+            storage = GRID_SHARED;
+        else if (strcmp(argv[i], "-s") == 0 && strcmp(value, "forward") == 0)
+            bidirectional = false;
+        else if (strcmp(argv[i], "-s") == 0 && strcmp(value, "bidir") == 0)
+            bidirectional = true;
+        else if (strcmp(argv[i], "-j") == 0 && jump_parse(value, &jump_mode))
+            ;
+        else if (strcmp(argv[i], "-L") == 0 && atoi(value) > 0)
+            landmark_count = atoi(value);
+        else if (strcmp(argv[i], "-C") == 0)
+            landmark_file = value;
+        else if (strcmp(argv[i], "-H") == 0 && atoi(value) > 0)
+            cluster_side = atoi(value);
+        else if (strcmp(argv[i], "-c") == 0)
+            cluster_file = value;
+        else if (strcmp(argv[i], "-Q") == 0)
+            query_file = value;
+        else if (strcmp(argv[i], "-o") == 0)
+            dump_prefix = value;
+        else if (strcmp(argv[i], "-S") == 0 && strcmp(value, "table") == 0)
+            stats_table = true;
+        else if (strcmp(argv[i], "-S") == 0 && strcmp(value, "peers") == 0)
+            stats_table = stats_peers = true;
+        else if (strcmp(argv[i], "-T") == 0)
+            trace_file = value;
+        else
+        {
+            fprintf(stderr, "Invalid option: %s %s\n", argv[i], value);
+            usage();
+            return 1;
+        }
+    }
+
+    if (bidirectional && threads > 1)
+    {
+        fprintf(stderr, "The hybrid engine only searches forward\n");
+        usage();
+        return 1;
+    }
+    if (bidirectional && cluster_side > 0)
+    {
+        fprintf(stderr, "The hierarchical engine only searches forward\n");
+        usage();
+        return 1;
+    }
+
+    // Only the main thread of the hybrid engine calls MPI
+    int provided;
+    MPI_Init_thread(NULL, NULL, threads > 1 ? MPI_THREAD_FUNNELED : MPI_THREAD_SINGLE, &provided);
+    if (threads > 1 && provided < MPI_THREAD_FUNNELED)
+    {
+        fprintf(stderr, "The MPI library does not support threads\n");
+        MPI_Finalize();
+        return 1;
+    }
 
     // Get the number of processes
     int world_size, rank;
     MPI_Comm_size(MPI_COMM_WORLD, &world_size);
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 
-    // Set seed, if seed equal 0 then generate random one
+    // Set seed, if seed equal 0 then generate random one, the same for all the
+    // processes since each one may generate its own cells
     unsigned seed = atoi(argv[1]);
     seed = (seed == 0) ? time(NULL) % 1000 : seed;
-    srandom(seed);
+    MPI_Bcast(&seed, 1, MPI_UNSIGNED, 0, MPI_COMM_WORLD);
 
     // Set width and height
     int width = atoi(argv[2]);
@@ -505,49 +2546,270 @@ int main(int argc, char *argv[])
     // Sel algorithm (Djikstra, A*, Approx)
     alpha = atoi(argv[5]);
 
+    // The processes of a node, which can share memory
+    MPI_Comm node_comm;
+    int node_rank;
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node_comm);
+    MPI_Comm_rank(node_comm, &node_rank);
+
+    if (storage == GRID_LOCAL && part_kind != PART_BLOCK)
+    {
+        fprintf(stderr, "Local grids require -p block\n");
+        MPI_Finalize();
+        return 1;
+    }
+    if (storage == GRID_LOCAL && landmark_count > 0)
+    {
+        fprintf(stderr, "Landmarks require the whole grid\n");
+        MPI_Finalize();
+        return 1;
+    }
+    if (storage == GRID_LOCAL && cluster_side > 0)
+    {
+        fprintf(stderr, "Clusters require the whole grid\n");
+        MPI_Finalize();
+        return 1;
+    }
+    if (storage == GRID_LOCAL && query_file != NULL)
+    {
+        fprintf(stderr, "Batch queries require the whole grid\n");
+        MPI_Finalize();
+        return 1;
+    }
+
+    // The processes generating the grid together: all of them, or the first
+    // one of every node for a shared grid
+    double generation_time = MPI_Wtime();
+    MPI_Comm build_comm = MPI_COMM_WORLD;
+    if (storage == GRID_SHARED)
+        MPI_Comm_split(MPI_COMM_WORLD, node_rank == 0 ? 0 : MPI_UNDEFINED, rank, &build_comm);
+
     // Set Grid according to type provided
+    const int cw = 3; // corridor width of the mazes
     grid G;
-    if (strcmp(type, "empty") == 0)
+    if (storage == GRID_SHARED && node_rank != 0)
+    {
+        // Built by the first process of the node, see shareGrid() below
+        G.value = NULL;
+    }
+    else if (storage == GRID_LOCAL &&
+             (strcmp(type, "empty") == 0 || strcmp(type, "walls") == 0 || strcmp(type, "maze") == 0 ||
+              gridFileSize(type, &width, &height)))
     {
-        G = initGridPoints(width, height, V_FREE, 1);
+        // The partition comes first, each process generates or reads its block only
+        if (strcmp(type, "maze") == 0)
+        {
+            // Dimensions of the maze, see initGridLaby()
+            width = (width / (cw + 1) < 3 ? 3 : width / (cw + 1)) * (cw + 1) + 1;
+            height = (height / (cw + 1) < 3 ? 3 : height / (cw + 1)) * (cw + 1) + 1;
+        }
+        width = width < 3 ? 3 : width;
+        height = height < 3 ? 3 : height;
+        part = partition_create(part_kind, width, height, world_size * threads, part_side);
+
+        // Bounding box of the blocks of the threads of the process
+        int x0 = width, y0 = height, x1 = 0, y1 = 0;
+        for (int w = rank * threads; w < (rank + 1) * threads; w++)
+        {
+            int bx0, by0, bx1, by1;
+            partition_block(&part, w, &bx0, &by0, &bx1, &by1);
+            x0 = bx0 < x0 ? bx0 : x0;
+            y0 = by0 < y0 ? by0 : y0;
+            x1 = bx1 > x1 ? bx1 : x1;
+            y1 = by1 > y1 ? by1 : y1;
+        }
+        if (strcmp(type, "empty") == 0)
+            G = initGridPointsBlock(width, height, V_FREE, 1, seed, x0, y0, x1, y1, threads);
+        else if (strcmp(type, "walls") == 0)
+            G = initGridPointsBlock(width, height, V_WALL, 0.2, seed, x0, y0, x1, y1, threads);
+        else if (strcmp(type, "maze") == 0)
+            G = initGridLabyBlock(width / (cw + 1), height / (cw + 1), cw, seed, x0, y0, x1, y1, threads);
+        else
+            G = initGridFileBlock(type, x0, y0, x1, y1, MPI_COMM_WORLD);
+    }
+    else if (storage == GRID_LOCAL)
+    {
+        fprintf(stderr, "Unknown type provided for a local grid: %s\nTypes allowed: empty, walls, maze, or a grid file\n", type);
+        MPI_Finalize();
+        return 1;
+    }
+    else if (strcmp(type, "empty") == 0)
+    {
+        G = initGridPoints(width, height, V_FREE, 1, seed, build_comm, threads);
     }
     else if (strcmp(type, "walls") == 0)
     {
-        G = initGridPoints(width, height, V_WALL, 0.2);
+        G = initGridPoints(width, height, V_WALL, 0.2, seed, build_comm, threads);
     }
     else if (strcmp(type, "maze") == 0)
     {
-        int cw = 3;
-        G = initGridLaby(width / (cw + 1), height / (cw + 1), cw);
+        G = initGridLaby(width / (cw + 1), height / (cw + 1), cw, seed, build_comm, threads);
+    }
+    else if (isGridFile(type))
+    {
+        // The dimensions are the ones of the file
+        G = initGridFile(type);
+        width = G.X;
+        height = G.Y;
     }
     else
     {
-        fprintf(stderr, "Unknown type provided: %s\nTypes allowed: empty, walls, maze", type);
+        fprintf(stderr, "Unknown type provided: %s\nTypes allowed: empty, walls, maze, or a grid file", type);
         return 1;
     }
 
+    if (storage == GRID_SHARED)
+    {
+        if (build_comm != MPI_COMM_NULL)
+            MPI_Comm_free(&build_comm);
+        G = shareGrid(G, node_comm);
+
+        // Only the first process of the node knows the dimensions of a grid file
+        width = G.X;
+        height = G.Y;
+    }
+    if (storage != GRID_LOCAL)
+        part = partition_create(part_kind, G.X, G.Y, world_size * threads, part_side);
+    generation_time = MPI_Wtime() - generation_time;
+    MPI_Allreduce(MPI_IN_PLACE, &generation_time, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+
+    // The landmarks are read from the cache, or computed by all the processes
+    // and threads then cached
+    double landmark_time = 0;
+    bool landmark_cached = false;
+    if (landmark_count > 0)
+    {
+        landmark_time = MPI_Wtime();
+        if (landmark_file != NULL)
+            alt = landmark_load(&G, landmark_count, weight, landmark_file);
+        int loaded = alt != NULL;
+        MPI_Allreduce(MPI_IN_PLACE, &loaded, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+        landmark_cached = loaded;
+        if (!loaded)
+        {
+            if (alt != NULL)
+                landmark_destroy(alt);
+            alt = landmark_create(&G, landmark_count, weight, MPI_COMM_WORLD, threads);
+            if (alt != NULL && landmark_file != NULL && rank == 0 && !landmark_save(alt, &G, landmark_file))
+                fprintf(stderr, "Cannot write the landmarks to %s\n", landmark_file);
+        }
+        landmark_time = MPI_Wtime() - landmark_time;
+        if (alt == NULL)
+            fprintf(stderr, "Not enough memory for the landmarks\n");
+        else
+            hbase = hlandmark;
+    }
+
+    // Same for the abstract graph of the clusters, whose processes and threads
+    // share the clusters
+    double cluster_time = 0;
+    bool cluster_cached = false;
+    if (cluster_side > 0)
+    {
+        cluster_time = MPI_Wtime();
+        if (cluster_file != NULL)
+            clusters = hpa_load(&G, cluster_side, cluster_file);
+        int loaded = clusters != NULL;
+        MPI_Allreduce(MPI_IN_PLACE, &loaded, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+        cluster_cached = loaded;
+        if (!loaded)
+        {
+            if (clusters != NULL)
+                hpa_destroy(clusters);
+            clusters = hpa_create(&G, cluster_side, weight, MPI_COMM_WORLD, threads);
+            if (clusters != NULL && cluster_file != NULL && rank == 0 && !hpa_save(clusters, &G, cluster_file))
+                fprintf(stderr, "Cannot write the abstract graph to %s\n", cluster_file);
+        }
+        cluster_time = MPI_Wtime() - cluster_time;
+        if (clusters == NULL)
+            fprintf(stderr, "Not enough memory for the clusters\n");
+    }
+
+    // The processes of a batch search alone, -t only gives threads to the builds
     double (*f)(grid, heuristic);
-    if (world_size > 1)
+    if (clusters != NULL)
+        f = A_star_hpa;
+    else if (threads > 1 && query_file == NULL)
+        f = A_star_hybrid;
+    else if (world_size > 1 && query_file == NULL)
         f = A_star_mpi;
+    else if (bidirectional)
+        f = A_star_bidirectional;
+    else if (jump_mode != JUMP_OFF && jump_uniform(&G))
+        f = A_star_jps;
     else
         f = A_star_sequential;
 
+    // The walls for the jump points are built once per grid, before the search
+    double jump_time = 0;
+    if (f == A_star_jps)
+    {
+        jump_time = MPI_Wtime();
+        jumps = jump_create(&G, jump_mode);
+        jump_time = MPI_Wtime() - jump_time;
+        if (jumps == NULL)
+        {
+            fprintf(stderr, "Not enough memory for the jump points\n");
+            f = A_star_sequential;
+        }
+    }
+
+    if (query_file != NULL)
+    {
+        bool ok = runBatch(G, f, bidirectional ? hbidir : hbase, query_file, generation_time,
+                           landmark_time + jump_time + cluster_time, rank, world_size);
+        releaseAll(G, &node_comm);
+        return ok ? 0 : 1;
+    }
+
     double d, start, delta;
+    if (trace_file != NULL)
+        tracer = trace_create(TRACE_EVENTS, MPI_COMM_WORLD);
+    stats_start(&stats, world_size, stats_table || tracer != NULL);
     start = MPI_Wtime();
-    d = f(G, halpha);
+    d = f(G, bidirectional ? hbidir : hbase);
     delta = MPI_Wtime() - start;
-
-    // path found or not?
-    if (d < 0)
+    stopPhases();
+    if (f != A_star_mpi && f != A_star_hybrid)
+        stats.expanded = expansions;
+
+    // The partition gives the cells to the workers, threads of the processes
+    int dst_process = hda(G.end) / threads;
+
+    // Sum the node allocation statistics of all the processes
+    long node_counts[2] = {node_stats.objects, node_stats.mallocs}, total_counts[2];
+    unsigned long node_bytes = node_stats.bytes, total_bytes;
+    MPI_Reduce(node_counts, total_counts, 2, MPI_LONG, MPI_SUM, dst_process, MPI_COMM_WORLD);
+    MPI_Reduce(&node_bytes, &total_bytes, 1, MPI_UNSIGNED_LONG, MPI_SUM, dst_process, MPI_COMM_WORLD);
+
+    // Grid memory of the most loaded node: values (once per node if shared) and marks
+    unsigned long grid_bytes = (storage == GRID_SHARED && node_rank != 0 ? 1 : 2) * gridSize(&G);
+    unsigned long node_grid_bytes, max_grid_bytes;
+    MPI_Allreduce(&grid_bytes, &node_grid_bytes, 1, MPI_UNSIGNED_LONG, MPI_SUM, node_comm);
+    MPI_Reduce(&node_grid_bytes, &max_grid_bytes, 1, MPI_UNSIGNED_LONG, MPI_MAX, dst_process, MPI_COMM_WORLD);
+
+    // Every process writes its own cells, the marks of all of them are merged
+    double dump_time = 0;
+    if (dump_prefix != NULL)
     {
-        printf("path not found!\n");
-        freeGrid(G);
-        return 1;
+        dump_time = MPI_Wtime();
+        char *name = malloc(strlen(dump_prefix) + 8);
+        sprintf(name, "%s.values", dump_prefix);
+        saveGridValueFile(G, name, MPI_COMM_WORLD);
+        sprintf(name, "%s.marks", dump_prefix);
+        saveGridMarkFile(G, name, MPI_COMM_WORLD);
+        free(name);
+        dump_time = MPI_Wtime() - dump_time;
     }
 
-    int dst_process = hda(G.end, world_size);
+    // The trace shows the search whether it found a path or not
+    if (trace_file != NULL && !trace_write(tracer, trace_file, trace_names) && rank == 0)
+        fprintf(stderr, "Cannot write the trace %s\n", trace_file);
 
-    if (rank == dst_process)
+    // path found or not? The counters matter most when it is not
+    if (d < 0)
+        printf("path not found!\n");
+    else if (rank == dst_process)
     {
         // TODO: MPI_Gather on Grid to update it with all other processes Grid
 
@@ -555,13 +2817,31 @@ int main(int argc, char *argv[])
         // int m = 0;
         // for (int i = 0; i < G.X; i++)
         //     for (int j = 0; j < G.Y; j++)
-        //         m += (G.mark[i][j] != M_NULL);
+        //         m += (gridMark(&G, i, j) != M_NULL);
         // printf("#nodes explored: %i\n", m);
 
         printf("Nb_cores: %d\nDimensions: %d\nBingo! Path found.. Cost: %g\tPerf: %lgs\n", world_size, width, d, delta);
+        printf("Nodes: %ld\tMallocs: %ld\tBytes: %lu\tExpanded: %ld\n", total_counts[0], total_counts[1], total_bytes,
+               expansions);
+        printf("Grid: %s\tBytes per node: %lu\tGeneration: %lgs\n", storage_names[storage], max_grid_bytes,
+               generation_time);
+        if (alt != NULL)
+            printf("Landmarks: %d\tBuild: %lgs\tBytes: %lu\tCached: %s\n", alt->K, landmark_time,
+                   landmark_bytes(alt), landmark_cached ? "yes" : "no");
+        if (jumps != NULL)
+            printf("Jump: %s\tBuild: %lgs\tBytes: %lu\n", jump_names[jump_mode], jump_time, jump_bytes(jumps));
+        if (clusters != NULL)
+            printf("Clusters: %dx%d\tAbstract nodes: %d\tBuild: %lgs\tBytes: %lu\tCached: %s\n", clusters->CX,
+                   clusters->CY, clusters->n, cluster_time, hpa_bytes(clusters), cluster_cached ? "yes" : "no");
+        if (dump_prefix != NULL)
+            printf("Dump: %s.values %s.marks\tTime: %lgs\n", dump_prefix, dump_prefix, dump_time);
+        if ((world_size > 1 || threads > 1) && clusters == NULL)
+            printf("Partition: %s\tOff-rank: %.3f\tImbalance: %.3f\tMessages: %ld\tThreads: %d\n",
+                   partition_name(part_kind), send_ratio, load_imbalance, messages, threads);
     }
+    if (stats_table)
+        stats_print(&stats, MPI_COMM_WORLD, dst_process, stats_peers);
 
-    freeGrid(G);
-    MPI_Finalize();
-    return 0;
+    releaseAll(G, &node_comm);
+    return d < 0 ? 1 : 0;
 }
\ No newline at end of file
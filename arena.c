@@ -0,0 +1,65 @@
+#include "arena.h"
+#include <stdlib.h>
+
+#define INIT_CHUNKS 16 // initial capacity of the chunks array
+
+arena arena_create(size_t size, int shift)
+{
+  arena a = malloc(sizeof(struct arena));
+  a->maxchunks = INIT_CHUNKS;
+  a->chunks = malloc(a->maxchunks * sizeof(char *));
+  a->nchunks = 0;
+  a->size = size;
+  a->shift = shift;
+  a->n = 0;
+  return a;
+}
+
+void arena_destroy(arena a)
+{
+  for (int i = 0; i < a->nchunks; i++)
+    free(a->chunks[i]);
+  free(a->chunks);
+  free(a);
+}
+
+void *arena_alloc(arena a)
+{
+  long c = a->n >> a->shift; // chunk of the new object
+  if (c == a->nchunks)
+  {
+    if (a->nchunks == a->maxchunks)
+    {
+      int k = a->maxchunks * 2;
+      char **chunks = realloc(a->chunks, k * sizeof(char *));
+      if (chunks == NULL)
+        return NULL;
+      a->chunks = chunks;
+      a->maxchunks = k;
+    }
+    char *chunk = malloc(a->size << a->shift);
+    if (chunk == NULL)
+      return NULL;
+    a->chunks[a->nchunks++] = chunk;
+  }
+  return arena_get(a, a->n++);
+}
+
+void arena_reset(arena a)
+{
+  a->n = 0;
+}
+
+arena_stats arena_get_stats(arena a)
+{
+  // The number of calls to malloc()/realloc() is derived from the
+  // number of chunks and the number of times the chunks array doubled.
+  arena_stats s;
+  int grows = 0;
+  for (int k = INIT_CHUNKS; k < a->maxchunks; k *= 2)
+    grows++;
+  s.objects = a->n;
+  s.mallocs = 2 + grows + a->nchunks; // arena + chunks array + chunks
+  s.bytes = sizeof(struct arena) + a->maxchunks * sizeof(char *) + ((size_t)a->nchunks * a->size << a->shift);
+  return s;
+}
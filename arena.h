@@ -0,0 +1,60 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Chunked arena allocator for fixed-size objects (search nodes).
+//
+//  chunks     = array of chunks, each one holding 1 << shift objects
+//  nchunks    = number of chunks allocated so far
+//  maxchunks  = capacity of the chunks array
+//  size       = size in bytes of one object
+//  shift      = log2 of the number of objects per chunk
+//  n          = number of objects handed out since the last reset
+//
+// Objects are never moved nor freed individually: pointers returned by
+// arena_alloc() stay valid until arena_reset() or arena_destroy(), which
+// release everything in bulk. Chunks are kept across resets so that a
+// reused arena does not call malloc() again.
+typedef struct arena
+{
+  char **chunks;
+  int nchunks, maxchunks;
+  size_t size;
+  int shift;
+  long n;
+} *arena;
+
+// Allocation statistics of an arena.
+typedef struct
+{
+  long objects; // objects handed out
+  long mallocs; // calls to malloc()/realloc() made by the arena
+  size_t bytes; // bytes reserved by the arena
+} arena_stats;
+
+// Creates an arena of objects of the given size, allocated by chunks
+// of 1 << shift objects.
+arena arena_create(size_t size, int shift);
+
+// Frees all the memory held by arena a, including the objects.
+void arena_destroy(arena a);
+
+// Returns a pointer to a new uninitialised object, or NULL if there is
+// not enough memory.
+void *arena_alloc(arena a);
+
+// Returns the i-th object handed out since the last reset, 0<=i<a->n.
+static inline void *arena_get(arena a, long i)
+{
+  return a->chunks[i >> a->shift] + (i & ((1L << a->shift) - 1)) * a->size;
+}
+
+// Forgets all the objects handed out so far, keeping the chunks for
+// later allocations.
+void arena_reset(arena a);
+
+// Returns the allocation statistics of arena a.
+arena_stats arena_get_stats(arena a);
+
+#endif
@@ -0,0 +1,171 @@
+#!/bin/bash
+# Benchmarks a_star on this machine, through mpirun, over a sweep of grid
+# types, sizes, seeds, algorithms, search directions and numbers of
+# processes. Every configuration runs REPEAT times, and the median, minimum
+# and standard deviation of its generation time, search time, path cost,
+# nodes expanded and messages between processes are written to $OUT.csv and
+# $OUT.json. The medians are also printed. A bidirectional configuration
+# also reports the share of the expansions it saved over the forward one,
+# when both are run.
+#
+# Usage: ./bench.sh (or make bench, which builds a_star first)
+#   e.g. RANKS="1 2 4 8" SIZES=4000 TYPES=maze ./bench.sh
+#        DIRS="forward bidir" ./bench.sh
+# Environment, the lists are separated by spaces:
+#   TYPES   grid types (default: "walls maze")
+#   SIZES   widths of the square grids (default: "1000 2000")
+#   SEEDS   seeds of the grids (default: "2 3")
+#   ALPHAS  algorithms, 0 (Dijkstra) or 1 (A*) (default: "0 1")
+#   DIRS    search directions, forward or bidir (default: forward), with bidir
+#           the forward searches do not jump (-j off) so that both directions
+#           run the same engine
+#   RANKS   numbers of processes (default: "1 2 4")
+#   REPEAT  runs of every configuration (default: 3)
+#   OPTS    options of a_star (default: none)
+#   MPIRUN  command starting the processes (default: mpirun)
+#   OUT     prefix of the result files (default: bench)
+
+types=${TYPES:-walls maze}
+sizes=${SIZES:-1000 2000}
+seeds=${SEEDS:-2 3}
+alphas=${ALPHAS:-0 1}
+dirs=${DIRS:-forward}
+ranks=${RANKS:-1 2 4}
+repeat=${REPEAT:-3}
+opts=${OPTS:-}
+mpirun=${MPIRUN:-mpirun}
+out=${OUT:-bench}
+
+# A single process searches forward with jump points on their own grids,
+# which the bidirectional search does not use
+jump=
+case " $dirs " in
+*" bidir "*) jump="-j off" ;;
+esac
+
+# Prints "generation search cost expanded messages" of a run, nothing if no
+# path is found. The values are the ones of the "Key: value" fields of the
+# output, the messages are only printed for several processes.
+run() {
+    $mpirun -n "$6" ./a_star "$3" "$2" "$2" "$1" "$4" -s "$5" $jump $opts 2>/dev/null | awk -F '\t' '
+        {
+            for (i = 1; i <= NF; i++) {
+                if (split($i, kv, ": ") != 2)
+                    continue
+                k = kv[1]
+                sub(/.* /, "", k)
+                v = kv[2]
+                sub(/s$/, "", v)
+                val[k] = v
+            }
+        }
+        END {
+            if ("Cost" in val)
+                print val["Generation"] + 0, val["Perf"] + 0, val["Cost"] + 0, val["Expanded"] + 0, val["Messages"] + 0
+        }'
+}
+
+# Reads the runs, one "type size seed alpha dir ranks" configuration and its
+# measures per line, and writes the statistics of every configuration. The
+# expansions saved compare the medians of a bidir configuration and of the
+# forward one.
+stats() {
+    awk -v csv="$out.csv" -v json="$out.json" '
+        function sort(a, n,    i, j, t) {
+            for (i = 2; i <= n; i++)
+                for (j = i; j > 1 && a[j - 1] > a[j]; j--) {
+                    t = a[j]; a[j] = a[j - 1]; a[j - 1] = t
+                }
+        }
+        BEGIN {
+            split("generation search cost expanded messages", name, " ")
+            m = 5
+            printf "type,size,seed,alpha,dir,ranks,runs" > csv
+            for (k = 1; k <= m; k++)
+                printf ",%s_median,%s_min,%s_stddev", name[k], name[k], name[k] > csv
+            printf ",expanded_saved\n" > csv
+            printf "[" > json
+            printf "type\tsize\tseed\talpha\tdir\tranks\tgeneration(s)\tsearch(s)\tcost\texpanded\tmessages\tsaved\n"
+        }
+        {
+            key = $1 " " $2 " " $3 " " $4 " " $5 " " $6
+            if (!(key in runs)) {
+                order[++configs] = key
+                runs[key] = 0
+            }
+            r = ++runs[key]
+            for (k = 1; k <= m; k++)
+                v[key, k, r] = $(6 + k)
+        }
+        END {
+            for (c = 1; c <= configs; c++) {
+                key = order[c]
+                n = runs[key]
+                for (k = 1; k <= m; k++) {
+                    sum = 0
+                    for (r = 1; r <= n; r++) {
+                        a[r] = v[key, k, r]
+                        sum += a[r]
+                    }
+                    sort(a, n)
+                    median[key, k] = n % 2 ? a[(n + 1) / 2] : (a[n / 2] + a[n / 2 + 1]) / 2
+                    least[key, k] = a[1]
+                    mean = sum / n
+                    var = 0
+                    for (r = 1; r <= n; r++)
+                        var += (a[r] - mean) ^ 2
+                    stddev[key, k] = n > 1 ? sqrt(var / (n - 1)) : 0
+                }
+            }
+            for (c = 1; c <= configs; c++) {
+                key = order[c]
+                n = runs[key]
+                split(key, f, " ")
+
+                # Share of the expansions of the forward search saved by the bidirectional one
+                forward = f[1] " " f[2] " " f[3] " " f[4] " forward " f[6]
+                saved = ""
+                if (f[5] == "bidir" && (forward, 4) in median && median[forward, 4] > 0)
+                    saved = sprintf("%.3f", 1 - median[key, 4] / median[forward, 4])
+
+                printf "%s,%s,%s,%s,%s,%s,%d", f[1], f[2], f[3], f[4], f[5], f[6], n > csv
+                printf "%s\n  {\"type\": \"%s\", \"size\": %s, \"seed\": %s, \"alpha\": %s, \"dir\": \"%s\", \"ranks\": %s, \"runs\": %d",
+                       (c > 1 ? "," : ""), f[1], f[2], f[3], f[4], f[5], f[6], n > json
+                line = f[1] "\t" f[2] "\t" f[3] "\t" f[4] "\t" f[5] "\t" f[6]
+                for (k = 1; k <= m; k++) {
+                    printf ",%.6g,%.6g,%.6g", median[key, k], least[key, k], stddev[key, k] > csv
+                    printf ", \"%s\": {\"median\": %.6g, \"min\": %.6g, \"stddev\": %.6g}", name[k], median[key, k],
+                           least[key, k], stddev[key, k] > json
+                    line = line "\t" sprintf("%.6g", median[key, k])
+                }
+                printf ",%s\n", saved > csv
+                if (saved != "")
+                    printf ", \"expanded_saved\": %s", saved > json
+                printf "}" > json
+                print line "\t" (saved == "" ? "-" : saved)
+            }
+            printf "\n]\n" > json
+        }'
+}
+
+for type in $types; do
+    for size in $sizes; do
+        for seed in $seeds; do
+            for alpha in $alphas; do
+                for dir in $dirs; do
+                    for n in $ranks; do
+                        for ((i = 0; i < repeat; i++)); do
+                            measures=$(run "$type" "$size" "$seed" "$alpha" "$dir" "$n")
+                            if [ -z "$measures" ]; then
+                                echo "$type $size seed $seed alpha $alpha $dir: no path with $n processes" >&2
+                                continue
+                            fi
+                            echo "$type $size $seed $alpha $dir $n $measures"
+                        done
+                    done
+                done
+            done
+        done
+    done
+done | stats
+echo "Results written to $out.csv and $out.json"
@@ -0,0 +1,46 @@
+#!/bin/bash
+# Compares the threaded engine (-t N, no mpirun) with the sequential engine on
+# the same grids. For each number of threads, prints the median search time
+# over the seeds and the speedup over the sequential engine, and checks that
+# the costs found are the same.
+#
+# Usage: ./bench_threads.sh [width] [type] [alpha] [threads...]
+#   e.g. ./bench_threads.sh 4000 walls 0 2 4 8 16 32
+# Environment: SEEDS (default: "1 2 3 4 5"), OPTS for a_star (default: "-p abstract")
+
+width=${1:-2000}
+type=${2:-walls}
+alpha=${3:-0}
+shift $(($# < 3 ? $# : 3))
+threads=${*:-2 4 8}
+seeds=${SEEDS:-1 2 3 4 5}
+opts=${OPTS:--p abstract}
+
+# Prints "cost time" of a run
+run() {
+    ./a_star "$1" "$width" "$width" "$type" "$alpha" -t "$2" $opts |
+        sed -n 's/.*Cost: \([^\t]*\)\tPerf: \(.*\)s$/\1 \2/p'
+}
+
+# Prints the median of the numbers read, one per line
+median() {
+    sort -g | awk '{ v[NR] = $1 } END { print (NR % 2) ? v[(NR + 1) / 2] : (v[NR / 2] + v[NR / 2 + 1]) / 2 }'
+}
+
+declare -A cost
+printf "threads\tmedian(s)\tspeedup\n"
+for t in 1 $threads; do
+    times=""
+    for s in $seeds; do
+        read -r c time <<<"$(run "$s" "$t")"
+        if [ "$t" = 1 ]; then
+            cost[$s]=$c
+        elif [ "$c" != "${cost[$s]}" ]; then
+            echo "seed $s: cost $c with $t threads, ${cost[$s]} sequential" >&2
+        fi
+        times+="$time"$'\n'
+    done
+    m=$(median <<<"${times%$'\n'}")
+    [ "$t" = 1 ] && base=$m
+    printf "%s\t%s\t%.2f\n" "$t" "$m" "$(awk -v a="$base" -v b="$m" 'BEGIN { print a / b }')"
+done
@@ -0,0 +1,208 @@
+#include "bucket.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INIT_BUCKETS 1024 // initial number of buckets
+
+bucket bucket_create(int k, size_t nkeys, double delta)
+{
+  bucket q = malloc(sizeof(struct bucket));
+  q->delta = delta;
+  q->nb = INIT_BUCKETS;
+  q->head = malloc(q->nb * sizeof(int));
+  memset(q->head, -1, q->nb * sizeof(int));
+  q->base = q->cur = 0;
+  q->entry = malloc(k * sizeof(bucket_entry));
+  q->nentry = 0;
+  q->nmax = k;
+  q->free = -1;
+  q->pos = calloc(nkeys, sizeof(int)); // pages are only touched for visited cells
+  q->n = 0;
+  return q;
+}
+
+void bucket_destroy(bucket q)
+{
+  free(q->head);
+  free(q->entry);
+  free(q->pos);
+  free(q);
+}
+
+int bucket_empty(bucket q)
+{
+  return q->n == 0;
+}
+
+// Makes bucket b part of the head array. The window [base,base+nb[ is
+// slid up to reuse the buckets below cur, which are all empty, before
+// growing the array. Returns true if there is not enough space.
+static bool bucket_reach(bucket q, long b)
+{
+  if (b >= q->base && b < q->base + q->nb)
+    return false;
+
+  long lo = b < q->cur ? b : q->cur; // lowest bucket that may be non-empty
+  long hi = b + 1;                   // one past the highest one
+  for (long i = q->nb - 1; i >= 0 && q->base + i >= hi; i--)
+    if (q->head[i] != -1)
+    {
+      hi = q->base + i + 1;
+      break;
+    }
+
+  long nb = q->nb;
+  while (nb < hi - lo)
+    nb *= 2;
+  if (nb != q->nb)
+  {
+    int *head = realloc(q->head, nb * sizeof(int));
+    if (head == NULL)
+      return true;
+    q->head = head;
+    memset(q->head + q->nb, -1, (nb - q->nb) * sizeof(int));
+  }
+
+  // move the buckets [lo,base+nb[ that are in use so that lo is the new base
+  long shift = lo - q->base; // may be negative
+  if (shift > 0)
+  {
+    long keep = q->nb - shift;
+    if (keep > 0)
+      memmove(q->head, q->head + shift, keep * sizeof(int));
+    else
+      keep = 0;
+    memset(q->head + keep, -1, (nb - keep) * sizeof(int));
+  }
+  else if (shift < 0)
+  {
+    long keep = nb + shift;
+    if (keep > 0)
+      memmove(q->head - shift, q->head, keep * sizeof(int));
+    else
+      keep = 0;
+    memset(q->head, -1, (nb - keep) * sizeof(int));
+  }
+  q->base = lo;
+  q->nb = nb;
+  return false;
+}
+
+// Links entry i at the head of bucket b.
+static bool bucket_link(bucket q, int i, long b)
+{
+  if (bucket_reach(q, b))
+    return true;
+  int *head = &q->head[b - q->base];
+  q->entry[i].b = b;
+  q->entry[i].prev = -1;
+  q->entry[i].next = *head;
+  if (*head != -1)
+    q->entry[*head].prev = i;
+  *head = i;
+  if (b < q->cur)
+    q->cur = b;
+  return false;
+}
+
+// Unlinks entry i from its bucket.
+static void bucket_unlink(bucket q, int i)
+{
+  bucket_entry *e = &q->entry[i];
+  if (e->prev != -1)
+    q->entry[e->prev].next = e->next;
+  else
+    q->head[e->b - q->base] = e->next;
+  if (e->next != -1)
+    q->entry[e->next].prev = e->prev;
+}
+
+// Bucket of score s.
+static inline long bucket_of(bucket q, double s)
+{
+  return (long)floor(s / q->delta);
+}
+
+bool bucket_add(bucket q, double score, double cost, size_t k, int id)
+{
+  int i = q->free;
+  if (i != -1)
+    q->free = q->entry[i].next;
+  else
+  {
+    if (q->nentry == q->nmax)
+    {
+      int nmax = q->nmax * 2;
+      bucket_entry *entry = realloc(q->entry, nmax * sizeof(bucket_entry));
+      if (entry == NULL)
+        return true;
+      q->entry = entry;
+      q->nmax = nmax;
+    }
+    i = q->nentry++;
+  }
+
+  q->entry[i].key = k;
+  q->entry[i].id = id;
+  q->pos[k] = i;
+  if (bucket_link(q, i, bucket_of(q, score)))
+    return true;
+  q->n++;
+  return false;
+}
+
+bool bucket_contains(bucket q, size_t k)
+{
+  int i = q->pos[k];
+  return i < q->nentry && q->entry[i].key == k;
+}
+
+int bucket_get(bucket q, size_t k)
+{
+  return q->entry[q->pos[k]].id;
+}
+
+bool bucket_decrease(bucket q, size_t k, double score, double cost)
+{
+  int i = q->pos[k];
+  long b = bucket_of(q, score);
+  if (b == q->entry[i].b)
+    return false;
+  bucket_unlink(q, i);
+  return bucket_link(q, i, b);
+}
+
+// Moves cur to the lowest non-empty bucket of q, which must not be empty.
+static void bucket_advance(bucket q)
+{
+  // no bucket below cur is non-empty, and cur is in the window
+  while (q->head[q->cur - q->base] == -1)
+    q->cur++;
+}
+
+double bucket_min_score(bucket q)
+{
+  if (q->n == 0)
+    return INFINITY;
+
+  bucket_advance(q);
+  return q->cur * q->delta;
+}
+
+int bucket_pop(bucket q)
+{
+  if (q->n == 0)
+    return -1;
+
+  bucket_advance(q);
+
+  int i = q->head[q->cur - q->base];
+  bucket_unlink(q, i);
+  int id = q->entry[i].id;
+  q->entry[i].key = SIZE_MAX;
+  q->entry[i].next = q->free;
+  q->free = i;
+  q->n--;
+  return id;
+}
@@ -0,0 +1,87 @@
+#ifndef BUCKET_H
+#define BUCKET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Entry of a bucket queue, linked in the list of its bucket.
+//
+//  key   = key of the entry (index of the cell of u in the grid), SIZE_MAX if
+//          free
+//  id    = index of the node u in its arena
+//  b     = bucket of the entry
+//  prev  = previous entry in the bucket, -1 for the first one
+//  next  = next entry in the bucket (or in the free list), -1 for the last one
+typedef struct
+{
+  size_t key;
+  int id;
+  long b;
+  int prev, next;
+} bucket_entry;
+
+// Bucket queue (Dial's algorithm) structure:
+//
+//  delta   = width of a bucket: a score s goes in bucket floor(s / delta)
+//  head    = head[i] is the first entry of bucket base + i, -1 if empty
+//  base    = bucket number of head[0]
+//  nb      = number of buckets in head
+//  cur     = no bucket below cur is non-empty
+//  entry   = storage array for entries
+//  nentry  = number of entries used in the entry array (stored or free)
+//  nmax    = capacity of the entry array
+//  free    = first free entry, -1 if none
+//  pos     = pos[k] is the index in entry of the entry with key k
+//  n       = number of entries stored in the queue
+//
+// The scores of A* only take a bounded set of increments (the terrain
+// weights of the grid), so the buckets that are in use form a window that
+// slides towards larger scores: add, decrease and pop are O(1) amortized.
+// Entries of the same bucket are extracted in LIFO order, their scores
+// differ by less than delta.
+typedef struct bucket
+{
+  double delta;
+  int *head;
+  long base, nb, cur;
+  bucket_entry *entry;
+  int nentry, nmax, free;
+  int *pos;
+  int n;
+} *bucket;
+
+// Creates a bucket queue with buckets of width delta>0, that can hold at
+// most k>0 entries before growing, with keys in [0,nkeys[.
+bucket bucket_create(int k, size_t nkeys, double delta);
+
+// Destroys bucket queue q.
+void bucket_destroy(bucket q);
+
+// Returns true if bucket queue q is empty, false otherwise.
+int bucket_empty(bucket q);
+
+// Adds node id with key k to bucket queue q. We will assume that k is not
+// already in q. Returns true if there is not enough space, and false
+// otherwise.
+bool bucket_add(bucket q, double score, double cost, size_t k, int id);
+
+// Returns true if an entry with key k is stored in bucket queue q.
+bool bucket_contains(bucket q, size_t k);
+
+// Returns the node id of the entry with key k, which must be stored in q.
+int bucket_get(bucket q, size_t k);
+
+// Lowers the score of the entry with key k, which must be stored in q.
+// Returns true if there is not enough space, and false otherwise.
+bool bucket_decrease(bucket q, size_t k, double score, double cost);
+
+// Returns a lower bound of the scores stored in bucket queue q (the lower
+// end of its lowest non-empty bucket), or +inf if q is empty.
+double bucket_min_score(bucket q);
+
+// Removes and returns the node id of an entry of the lowest non-empty
+// bucket of q. Returns -1 if the queue is empty.
+int bucket_pop(bucket q);
+
+#endif
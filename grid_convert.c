@@ -0,0 +1,28 @@
+#include "tools.h"
+
+// Converts the layout of a grid that saveGridValueFile() writes, or a grid
+// file, to a grid file that a_star reads in place of a generated grid: with
+// the rows as they are, which a_star maps in memory without reading them,
+// or compressed by tiles.
+int main(int argc, char *argv[])
+{
+    if (argc < 3 || argc > 4 || (argc == 4 && atoi(argv[3]) <= 0))
+    {
+        fprintf(stderr, "Usage: ./grid_convert <layout or grid file> <grid file> [tile side]\n"
+                        "  tile side  compresses the cells by tiles of this side (default: none)\n");
+        return 1;
+    }
+
+    grid G = isGridFile(argv[1]) ? initGridFile(argv[1]) : initGridText(argv[1]);
+    int tile = argc == 4 ? atoi(argv[3]) : 0;
+    if (!saveGridFile(G, argv[2], tile))
+    {
+        fprintf(stderr, "Cannot write the grid file %s\n", argv[2]);
+        freeGrid(G);
+        return 1;
+    }
+    printf("%s: %dx%d grid, start (%d,%d), end (%d,%d)\n", argv[2], G.X, G.Y, G.start.x, G.start.y, G.end.x,
+           G.end.y);
+    freeGrid(G);
+    return 0;
+}
@@ -1,19 +1,27 @@
 #include "heap.h"
+#include <math.h>
 #include <stdlib.h>
 
-heap heap_create(int k, int (*f)(const void *, const void *))
+// Returns true if entry a must be extracted before entry b.
+static inline bool heap_less(const heap_entry *a, const heap_entry *b)
+{
+  return a->score < b->score || (a->score == b->score && a->cost > b->cost);
+}
+
+heap heap_create(int k, size_t nkeys)
 {
   heap h = malloc(sizeof(struct heap));
-  h->array = malloc((k + 1) * sizeof(void *)); // k+1 because we start at 1
+  h->array = malloc(k * sizeof(heap_entry));
+  h->pos = calloc(nkeys, sizeof(int)); // pages are only touched for visited cells
   h->n = 0;
   h->nmax = k;
-  h->f = f;
   return h;
 }
 
 void heap_destroy(heap h)
 {
   free(h->array);
+  free(h->pos);
   free(h);
 }
 
@@ -24,77 +32,115 @@ int heap_empty(heap h)
   return 0;
 }
 
-bool heap_add(heap h, void *obj)
+// Stores entry e at index i of the heap.
+static inline void heap_set(heap h, int i, heap_entry e)
 {
-  if (h->n == h->nmax)
+  h->array[i] = e;
+  h->pos[e.key] = i;
+}
+
+// Moves the entry at index son up until its father is not greater.
+static void heap_up(heap h, int son)
+{
+  heap_entry e = h->array[son];
+  while (son > 0)
   {
-    int k = h->nmax * 2;
-    void **array = realloc(h->array, (k + 1) * sizeof(void *));
-    if (array == NULL)
-    {
-      return true;
-    }
-    else
-    {
-      h->array = array;
-      h->nmax = k;
-    }
+    int father = (son - 1) / HEAP_ARITY;
+    if (!heap_less(&e, &h->array[father]))
+      break;
+    heap_set(h, son, h->array[father]);
+    son = father;
   }
+  heap_set(h, son, e);
+}
 
-  // store object at the end
-  h->array[++h->n] = obj;
-
-  int son = h->n;
-  int father = son / 2;
-  while (father > 0 && h->f(h->array[father], h->array[son]) > 0)
+// Moves the entry at index father down until its sons are not lower.
+static void heap_down(heap h, int father)
+{
+  heap_entry e = h->array[father];
+  int first;
+  while ((first = father * HEAP_ARITY + 1) < h->n)
   {
-    node swap = h->array[father];
-    h->array[father] = h->array[son];
-    h->array[son] = swap;
+    // smallest of the (at most HEAP_ARITY) sons
+    int last = first + HEAP_ARITY < h->n ? first + HEAP_ARITY : h->n;
+    int son = first;
+    for (int i = first + 1; i < last; i++)
+      if (heap_less(&h->array[i], &h->array[son]))
+        son = i;
+
+    if (!heap_less(&h->array[son], &e))
+      break;
+    heap_set(h, father, h->array[son]);
+    father = son;
+  }
+  heap_set(h, father, e);
+}
 
-    son = father;
-    father = son / 2;
+bool heap_add(heap h, double score, double cost, size_t k, int id)
+{
+  if (h->n == h->nmax)
+  {
+    int nmax = h->nmax * 2;
+    heap_entry *array = realloc(h->array, nmax * sizeof(heap_entry));
+    if (array == NULL)
+      return true;
+    h->array = array;
+    h->nmax = nmax;
   }
+
+  // store entry at the end and move it up
+  heap_set(h, h->n++, (heap_entry){score, cost, k, id});
+  heap_up(h, h->n - 1);
   return false;
 }
 
-void *heap_top(heap h)
+bool heap_contains(heap h, size_t k)
+{
+  int i = h->pos[k];
+  return i < h->n && h->array[i].key == k;
+}
+
+int heap_get(heap h, size_t k)
 {
-  if (!h->array)
-    return NULL;
+  return h->array[h->pos[k]].id;
+}
 
-  return h->array[1];
+void heap_decrease(heap h, size_t k, double score, double cost)
+{
+  int i = h->pos[k];
+  h->array[i].score = score;
+  h->array[i].cost = cost;
+  heap_up(h, i);
 }
 
-void *heap_pop(heap h)
+int heap_top(heap h)
 {
   if (h->n == 0 || !h->array)
-    return NULL;
+    return -1;
 
-  // swap min and last
-  node swap = h->array[h->n];
-  h->array[h->n] = h->array[1];
-  h->array[1] = swap;
+  return h->array[0].id;
+}
 
-  // store deleted (min)
-  node deleted = h->array[h->n--];
+double heap_top_score(heap h)
+{
+  if (h->n == 0 || !h->array)
+    return INFINITY;
 
-  int father = 1;
-  int left_son = (father * 2 > h->n) ? father : father * 2;          // in case n < 2 (left_son is empty)
-  int right_son = (father * 2 + 1 > h->n) ? father : father * 2 + 1; // in case n < 3 (right_son is empty)
-  int son = (h->f(h->array[left_son], h->array[right_son]) > 0) ? right_son : left_son;
-  while (h->f(h->array[father], h->array[son]) > 0)
-  {
-    swap = h->array[father];
-    h->array[father] = h->array[son];
-    h->array[son] = swap;
+  return h->array[0].score;
+}
 
-    father = son;
-    left_son = (father * 2 > h->n) ? father : father * 2;
-    right_son = (father * 2 + 1 > h->n) ? father : father * 2 + 1;
+int heap_pop(heap h)
+{
+  if (h->n == 0 || !h->array)
+    return -1;
 
-    son = (h->f(h->array[left_son], h->array[right_son]) > 0) ? right_son : left_son;
+  // store deleted (min) and move the last entry to the top
+  int deleted = h->array[0].id;
+  if (--h->n > 0)
+  {
+    heap_set(h, 0, h->array[h->n]);
+    heap_down(h, 0);
   }
 
   return deleted;
-}
\ No newline at end of file
+}
@@ -23,48 +23,90 @@ typedef struct
     int parent_win_i;
 } mpi_node;
 
-// Binary heap structure:
+// Arity of the heap, set at build time (make HEAP_ARITY=2 for a binary heap).
+// A 4-ary heap is half as deep as a binary one and the 4 sons of an entry
+// fit in two cache lines, which makes heap_pop() miss the cache less.
+#ifndef HEAP_ARITY
+#define HEAP_ARITY 4
+#endif
+
+// Entry of the heap: the keys of the ordering are stored inline so that
+// comparisons never dereference a node.
+//
+//  score = score[u] of the node, smallest first
+//  cost  = cost[u] of the node, largest first among equal scores (ties
+//          are broken towards the nodes closest to the destination)
+//  key   = key of the entry (index of the cell of u in the grid)
+//  id    = index of the node u in its arena
+typedef struct
+{
+    double score;
+    double cost;
+    size_t key;
+    int id;
+} heap_entry;
+
+// Indexed d-ary heap structure:
+//
+//  array = storage array for entries, starting at index 0
+//  pos   = pos[k] is the index in array of the entry with key k
+//  n     = number of entries stored in the heap
+//  nmax  = number of entries that can be stored before the heap grows
 //
-//  array = storage array for objects starting at index 1 (instead of 0)
-//  n     = number of objects (which are void*) stored in the heap
-//  nmax  = maximum number of objects that can be stored in the heap
-//  f     = comparison function for two objects (min, max, ..., see man qsort)
+// Every entry is identified by an integer key in [0,nkeys[ (the index of
+// its cell in the grid), and a key is stored at most once. The pos[]
+// array is the handle that allows to find and move an entry whose score
+// decreased.
 //
 // Warning! "heap" is defined as a pointer to optimize calls (pushing
 // one word (= 1 pointer) instead of 4 otherwise).
 typedef struct heap
 {
-    void **array;
+    heap_entry *array;
+    int *pos;
     int n, nmax;
-
-    int (*f)(const void *, const void *);
 } *heap;
 
-// Creates a heap that can hold at most k>0 objects with a predefined
-// comparison function f(). NB: The size of an object pointed to by a
-// pointer h is sizeof(*h).
-heap heap_create(int k, int (*f)(const void *, const void *));
+// Creates a heap with an initial capacity of k>0 entries, doubled each
+// time it is full, with keys in [0,nkeys[.
+heap heap_create(int k, size_t nkeys);
 
 // Destroys heap h. We will assume h!=NULL. Warning! This is about
-// freeing what has been allocated by heap_create(). NB: The objects
-// stored in the heap do not have to be freed.
+// freeing what has been allocated by heap_create(). NB: The nodes
+// referenced by the heap do not have to be freed.
 void heap_destroy(heap h);
 
 // Returns true if heap h is empty, false otherwise. We will assume
 // h!=NULL.
 int heap_empty(heap h);
 
-// Adds an object to heap h. We will assume h!=NULL. Returns true if
-// there is not enough space, and false otherwise.
-bool heap_add(heap h, void *object);
+// Adds node id with key k to heap h. We will assume h!=NULL and that k
+// is not already in h. Returns true if there is not enough space, and
+// false otherwise.
+bool heap_add(heap h, double score, double cost, size_t k, int id);
+
+// Returns true if an entry with key k is stored in heap h.
+bool heap_contains(heap h, size_t k);
+
+// Returns the node id of the entry with key k, which must be stored in
+// heap h.
+int heap_get(heap h, size_t k);
+
+// Lowers the score of the entry with key k, which must be stored in
+// heap h, and restores the heap order (decrease-key).
+void heap_decrease(heap h, size_t k, double score, double cost);
+
+// Returns the node id at the top of heap h, that is, the minimal entry,
+// without deleting it. We will assume h!=NULL. Returns -1 if the heap
+// is empty.
+int heap_top(heap h);
 
-// Returns the object at the top of heap h, that is, the minimal
-// element according to f(), without deleting it. We will assume
-// h!=NULL. Returns NULL if the heap is empty.
-void *heap_top(heap h);
+// Returns the score of the entry at the top of heap h, or +inf if the
+// heap is empty.
+double heap_top_score(heap h);
 
-// Like heap_top() except that the object is also deleted from the
-// heap. Returns NULL if the heap is empty.
-void *heap_pop(heap h);
+// Like heap_top() except that the entry is also deleted from the heap.
+// Returns -1 if the heap is empty.
+int heap_pop(heap h);
 
 #endif
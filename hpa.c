@@ -0,0 +1,501 @@
+#include "hpa.h"
+#include <pthread.h>
+
+// Entrances of at least this number of cells get a transition at each end
+#define WIDE_ENTRANCE 6
+
+// Header of an abstract graph file, followed by the arrays at, first,
+// offset, intra, link_first and link.
+typedef struct
+{
+    char magic[8];
+    int X, Y, side, n;
+    long links, costs; // number of entries of link and intra
+    uint64_t grid_hash;  // of the values of the grid
+} hpa_header;
+
+static const char magic[8] = "HPA v1";
+
+// Transitions found on the borders, as pairs of neighbor cells of two clusters.
+typedef struct
+{
+    position *a, *b;
+    int n, nmax;
+} transitions;
+
+// Appends the transition (a,b) to T. Returns false if there is not enough memory.
+static bool addTransition(transitions *T, position a, position b)
+{
+    if (T->n == T->nmax)
+    {
+        int nmax = T->nmax ? 2 * T->nmax : 1024;
+        position *na = realloc(T->a, nmax * sizeof(position));
+        if (na != NULL)
+            T->a = na;
+        position *nb = realloc(T->b, nmax * sizeof(position));
+        if (nb != NULL)
+            T->b = nb;
+        if (na == NULL || nb == NULL)
+            return false;
+        T->nmax = nmax;
+    }
+    T->a[T->n] = a;
+    T->b[T->n] = b;
+    T->n++;
+    return true;
+}
+
+// Finds the entrances of the border between the cell (x,y), the first one of
+// a side of a cluster, and its neighbor (x+ox,y+oy) in the next cluster, over
+// len cells along (dx,dy). Returns false if there is not enough memory.
+static bool findEntrances(const grid *G, transitions *T, int x, int y, int ox, int oy, int dx, int dy, int len)
+{
+    bool ok = true;
+    for (int i = 0; i < len && ok;)
+    {
+        // An entrance is a run of free cells on both sides
+        int j = i;
+        while (j < len && gridValue(G, x + j * dx, y + j * dy) != V_WALL &&
+               gridValue(G, x + j * dx + ox, y + j * dy + oy) != V_WALL)
+            j++;
+        if (j - i >= WIDE_ENTRANCE)
+        {
+            ok = addTransition(T, (position){x + i * dx, y + i * dy}, (position){x + i * dx + ox, y + i * dy + oy});
+            int e = j - 1;
+            ok = ok && addTransition(T, (position){x + e * dx, y + e * dy}, (position){x + e * dx + ox, y + e * dy + oy});
+        }
+        else if (j > i)
+        {
+            int m = (i + j - 1) / 2;
+            ok = addTransition(T, (position){x + m * dx, y + m * dy}, (position){x + m * dx + ox, y + m * dy + oy});
+        }
+        i = j + 1;
+    }
+    return ok;
+}
+
+// Finds the transitions of all the borders between the clusters of H.
+static bool findTransitions(const grid *G, cluster_graph H, transitions *T)
+{
+    bool ok = true;
+    for (int cy = 0; cy < H->CY && ok; cy++)
+    {
+        for (int cx = 0; cx < H->CX && ok; cx++)
+        {
+            int x0 = cx * H->side, y0 = cy * H->side;
+            int w = x0 + H->side < H->X ? H->side : H->X - x0;
+            int h = y0 + H->side < H->Y ? H->side : H->Y - y0;
+            if (cx + 1 < H->CX) // right border
+                ok = findEntrances(G, T, x0 + H->side - 1, y0, 1, 0, 0, 1, h);
+            if (cy + 1 < H->CY && ok) // bottom border
+                ok = findEntrances(G, T, x0, y0 + H->side - 1, 0, 1, 1, 0, w);
+        }
+    }
+    return ok;
+}
+
+// Numbers the cells of the transitions T cluster by cluster into the nodes
+// of H, and links the two nodes of every transition. node_of has an entry
+// per cell of G. Returns false if there is not enough memory.
+static bool buildNodes(const grid *G, cluster_graph H, const transitions *T, int *node_of)
+{
+    int C = H->CX * H->CY;
+    for (size_t k = 0; k < gridSize(G); k++)
+        node_of[k] = -1;
+    for (int i = 0; i < T->n; i++)
+    {
+        node_of[gridIndex(G, T->a[i].x, T->a[i].y)] = 0;
+        node_of[gridIndex(G, T->b[i].x, T->b[i].y)] = 0;
+    }
+
+    // Nodes, cluster by cluster
+    H->n = 0;
+    for (int c = 0; c < C; c++)
+    {
+        int x0 = c % H->CX * H->side, y0 = c / H->CX * H->side;
+        for (int y = y0; y < y0 + H->side && y < H->Y; y++)
+            for (int x = x0; x < x0 + H->side && x < H->X; x++)
+                H->n += node_of[gridIndex(G, x, y)] == 0;
+    }
+    H->at = malloc(H->n * sizeof(position));
+    H->link_first = calloc(H->n + 1, sizeof(int));
+    H->link = malloc(2 * T->n * sizeof(int));
+    if (H->at == NULL || H->link_first == NULL || H->link == NULL)
+        return false;
+
+    int n = 0;
+    long costs = 0;
+    for (int c = 0; c < C; c++)
+    {
+        H->first[c] = n;
+        H->offset[c] = costs;
+        int x0 = c % H->CX * H->side, y0 = c / H->CX * H->side;
+        for (int y = y0; y < y0 + H->side && y < H->Y; y++)
+        {
+            for (int x = x0; x < x0 + H->side && x < H->X; x++)
+            {
+                int *k = node_of + gridIndex(G, x, y);
+                if (*k == 0)
+                {
+                    H->at[n] = (position){x, y};
+                    *k = n++;
+                }
+            }
+        }
+        costs += (long)(n - H->first[c]) * (n - H->first[c]);
+    }
+    H->first[C] = n;
+    H->offset[C] = costs;
+
+    // Links, counted per node then stored
+    for (int i = 0; i < T->n; i++)
+    {
+        H->link_first[node_of[gridIndex(G, T->a[i].x, T->a[i].y)] + 1]++;
+        H->link_first[node_of[gridIndex(G, T->b[i].x, T->b[i].y)] + 1]++;
+    }
+    for (int i = 0; i < H->n; i++)
+        H->link_first[i + 1] += H->link_first[i];
+    int *next = malloc(H->n * sizeof(int));
+    if (next == NULL)
+        return false;
+    memcpy(next, H->link_first, H->n * sizeof(int));
+    for (int i = 0; i < T->n; i++)
+    {
+        int a = node_of[gridIndex(G, T->a[i].x, T->a[i].y)];
+        int b = node_of[gridIndex(G, T->b[i].x, T->b[i].y)];
+        H->link[next[a]++] = b;
+        H->link[next[b]++] = a;
+    }
+    free(next);
+    return true;
+}
+
+// Allocates an abstract graph of G with clusters of side cells, without
+// nodes. Returns NULL if there is not enough memory.
+static cluster_graph allocGraph(const grid *G, int side)
+{
+    cluster_graph H = calloc(1, sizeof(struct cluster_graph));
+    if (H == NULL)
+        return NULL;
+    H->X = G->X;
+    H->Y = G->Y;
+    H->side = side;
+    H->CX = (G->X + side - 1) / side;
+    H->CY = (G->Y + side - 1) / side;
+    H->first = malloc((H->CX * H->CY + 1) * sizeof(int));
+    H->offset = malloc((H->CX * H->CY + 1) * sizeof(long));
+    if (H->first == NULL || H->offset == NULL)
+    {
+        hpa_destroy(H);
+        return NULL;
+    }
+    return H;
+}
+
+// Fills the costs between the nodes of cluster c with one search from each
+// of them. Returns false if there is not enough memory.
+static bool clusterCosts(cluster_graph H, hpa_search S, int c)
+{
+    int m = H->first[c + 1] - H->first[c];
+    double *d = H->intra + H->offset[c];
+    for (int a = 0; a < m; a++)
+    {
+        if (hpa_search_from(S, H->at[H->first[c] + a]) < 0)
+            return false;
+        for (int b = 0; b < m; b++)
+            d[a * m + b] = hpa_search_cost(S, H->at[H->first[c] + b]);
+    }
+    return true;
+}
+
+// Clusters computed by a thread: first, first + step, ...
+typedef struct
+{
+    cluster_graph H;
+    const grid *G;
+    const double *weight;
+    int first, step;
+    bool ok;
+    bool started; // whether the job runs on its own thread
+    pthread_t thread;
+} cluster_job;
+
+static void *runJob(void *arg)
+{
+    cluster_job *j = arg;
+    hpa_search S = hpa_search_create(j->H, j->G, j->weight);
+    j->ok = S != NULL;
+    for (int c = j->first; c < j->H->CX * j->H->CY && j->ok; c += j->step)
+        j->ok = clusterCosts(j->H, S, c);
+    if (S != NULL)
+        hpa_search_destroy(S);
+    return NULL;
+}
+
+cluster_graph hpa_create(const grid *G, int side, const double *weight, MPI_Comm comm, int threads)
+{
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    // Every process finds the same nodes, which are cheap to find
+    cluster_graph H = allocGraph(G, side);
+    transitions T = {NULL, NULL, 0, 0};
+    int *node_of = malloc(gridSize(G) * sizeof(int));
+    int ok = H != NULL && node_of != NULL && findTransitions(G, H, &T) && buildNodes(G, H, &T, node_of);
+    free(node_of);
+    free(T.a);
+    free(T.b);
+    if (ok)
+    {
+        long costs = H->offset[H->CX * H->CY];
+        H->intra = malloc(costs * sizeof(double));
+        ok = H->intra != NULL;
+        for (long k = 0; k < costs && ok; k++)
+            H->intra[k] = INFINITY;
+    }
+    if (ok)
+    {
+        // Cluster c is computed by process c % size, and by its thread c / size % threads
+        cluster_job *J = malloc(threads * sizeof(cluster_job));
+        if (J == NULL)
+            ok = false;
+        else
+        {
+            for (int t = 0; t < threads; t++)
+                J[t] = (cluster_job){H, G, weight, rank + t * size, size * threads, true, false};
+            for (int t = 1; t < threads; t++)
+                J[t].started = pthread_create(&J[t].thread, NULL, runJob, &J[t]) == 0;
+            runJob(&J[0]);
+            for (int t = 0; t < threads; t++)
+            {
+                if (J[t].started)
+                    pthread_join(J[t].thread, NULL);
+                else if (t > 0)
+                    runJob(&J[t]); // no thread left, this one does the job
+                ok &= J[t].ok;
+            }
+            free(J);
+        }
+    }
+
+    MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_LAND, comm);
+    if (!ok)
+    {
+        if (H != NULL)
+            hpa_destroy(H);
+        return NULL;
+    }
+
+    // Every process receives all the costs, the others are INFINITY on each
+    // process, by chunks whose count fits in an int
+    long costs = H->offset[H->CX * H->CY];
+    for (long k = 0; k < costs; k += INT_MAX)
+        MPI_Allreduce(MPI_IN_PLACE, H->intra + k, costs - k < INT_MAX ? costs - k : INT_MAX, MPI_DOUBLE, MPI_MIN,
+                      comm);
+    return H;
+}
+
+// Returns true if the arrays of H read from a file with the given numbers
+// of links and costs are consistent: the nodes are cells of the grid, the
+// nodes and the costs of the clusters follow each other, and the links are
+// nodes.
+static bool checkGraph(cluster_graph H, long links, long costs)
+{
+    int C = H->CX * H->CY;
+    if (H->first[0] != 0 || H->first[C] != H->n || H->offset[0] != 0 || H->offset[C] != costs ||
+        H->link_first[0] != 0 || H->link_first[H->n] != links)
+        return false;
+    for (int c = 0; c < C; c++)
+    {
+        long m = H->first[c + 1] - H->first[c];
+        if (m < 0 || H->offset[c + 1] - H->offset[c] != m * m)
+            return false;
+    }
+    for (int i = 0; i < H->n; i++)
+        if (H->at[i].x < 0 || H->at[i].x >= H->X || H->at[i].y < 0 || H->at[i].y >= H->Y ||
+            H->link_first[i] > H->link_first[i + 1])
+            return false;
+    for (long j = 0; j < links; j++)
+        if (H->link[j] < 0 || H->link[j] >= H->n)
+            return false;
+    return true;
+}
+
+cluster_graph hpa_load(const grid *G, int side, const char *file)
+{
+    FILE *f = fopen(file, "rb");
+    if (f == NULL)
+        return NULL;
+
+    hpa_header h;
+    cluster_graph H = NULL;
+    if (fread(&h, sizeof(h), 1, f) == 1 && memcmp(h.magic, magic, sizeof(magic)) == 0 && h.X == G->X &&
+        h.Y == G->Y && h.side == side && h.grid_hash == gridHash(G) && h.n >= 0 && h.links >= 0 && h.costs >= 0)
+        H = allocGraph(G, side);
+
+    bool ok = H != NULL;
+    if (ok)
+    {
+        int C = H->CX * H->CY;
+        H->n = h.n;
+        H->at = malloc(h.n * sizeof(position));
+        H->intra = malloc(h.costs * sizeof(double));
+        H->link_first = malloc((h.n + 1) * sizeof(int));
+        H->link = malloc(h.links * sizeof(int));
+        ok = H->at != NULL && H->intra != NULL && H->link_first != NULL && H->link != NULL &&
+             fread(H->at, sizeof(position), h.n, f) == (size_t)h.n &&
+             fread(H->first, sizeof(int), C + 1, f) == (size_t)C + 1 &&
+             fread(H->offset, sizeof(long), C + 1, f) == (size_t)C + 1 &&
+             fread(H->intra, sizeof(double), h.costs, f) == (size_t)h.costs &&
+             fread(H->link_first, sizeof(int), h.n + 1, f) == (size_t)h.n + 1 &&
+             fread(H->link, sizeof(int), h.links, f) == (size_t)h.links && checkGraph(H, h.links, h.costs);
+    }
+    fclose(f);
+    if (!ok && H != NULL)
+    {
+        hpa_destroy(H);
+        H = NULL;
+    }
+    return H;
+}
+
+bool hpa_save(cluster_graph H, const grid *G, const char *file)
+{
+    FILE *f = fopen(file, "wb");
+    if (f == NULL)
+        return false;
+
+    int C = H->CX * H->CY;
+    hpa_header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, magic, sizeof(magic));
+    h.X = G->X;
+    h.Y = G->Y;
+    h.side = H->side;
+    h.n = H->n;
+    h.links = H->link_first[H->n];
+    h.costs = H->offset[C];
+    h.grid_hash = gridHash(G);
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1 && fwrite(H->at, sizeof(position), H->n, f) == (size_t)H->n &&
+              fwrite(H->first, sizeof(int), C + 1, f) == (size_t)C + 1 &&
+              fwrite(H->offset, sizeof(long), C + 1, f) == (size_t)C + 1 &&
+              fwrite(H->intra, sizeof(double), h.costs, f) == (size_t)h.costs &&
+              fwrite(H->link_first, sizeof(int), H->n + 1, f) == (size_t)H->n + 1 &&
+              fwrite(H->link, sizeof(int), h.links, f) == (size_t)h.links;
+    return fclose(f) == 0 && ok;
+}
+
+void hpa_destroy(cluster_graph H)
+{
+    free(H->at);
+    free(H->first);
+    free(H->offset);
+    free(H->intra);
+    free(H->link_first);
+    free(H->link);
+    free(H);
+}
+
+size_t hpa_bytes(cluster_graph H)
+{
+    int C = H->CX * H->CY;
+    return H->n * sizeof(position) + (C + 1) * (sizeof(int) + sizeof(long)) + H->offset[C] * sizeof(double) +
+           (H->n + 1 + H->link_first[H->n]) * sizeof(int);
+}
+
+hpa_search hpa_search_create(cluster_graph H, const grid *G, const double *weight)
+{
+    hpa_search S = malloc(sizeof(struct hpa_search));
+    if (S == NULL)
+        return NULL;
+    size_t cells = (size_t)H->side * H->side;
+    S->H = H;
+    S->G = G;
+    S->weight = weight;
+    S->cost = malloc(cells * sizeof(double));
+    S->parent = malloc(cells * sizeof(int));
+    S->Q = heap_create(1024, cells);
+    if (S->cost == NULL || S->parent == NULL || S->Q == NULL)
+    {
+        hpa_search_destroy(S);
+        return NULL;
+    }
+    return S;
+}
+
+void hpa_search_destroy(hpa_search S)
+{
+    free(S->cost);
+    free(S->parent);
+    if (S->Q != NULL)
+        heap_destroy(S->Q);
+    free(S);
+}
+
+long hpa_search_from(hpa_search S, position s)
+{
+    const grid *G = S->G;
+    int side = S->H->side;
+    S->x0 = s.x / side * side;
+    S->y0 = s.y / side * side;
+    S->x1 = S->x0 + side < G->X ? S->x0 + side : G->X;
+    S->y1 = S->y0 + side < G->Y ? S->y0 + side : G->Y;
+    for (int k = 0; k < side * side; k++)
+        S->cost[k] = INFINITY;
+
+    int k = (s.y - S->y0) * side + (s.x - S->x0);
+    S->cost[k] = 0;
+    S->parent[k] = -1;
+    long expanded = 0;
+    bool ok = !heap_add(S->Q, 0, 0, k, k);
+    while (ok && !heap_empty(S->Q))
+    {
+        int u = heap_pop(S->Q); // ids are the keys: the indices in cost
+        int ux = S->x0 + u % side, uy = S->y0 + u / side;
+        expanded++;
+        for (int y = -1; y <= 1 && ok; y++)
+        {
+            for (int x = -1; x <= 1; x++)
+            {
+                int px = ux + x, py = uy + y;
+                if ((x == 0 && y == 0) || px < S->x0 || px >= S->x1 || py < S->y0 || py >= S->y1)
+                    continue;
+                int value = gridValue(G, px, py);
+                if (value == V_WALL)
+                    continue;
+                int v = (py - S->y0) * side + (px - S->x0);
+                double c = S->cost[u] + S->weight[value];
+                if (S->cost[v] == INFINITY)
+                    ok = !heap_add(S->Q, c, c, v, v);
+                else if (c < S->cost[v]) // v is still open, a closed cell has its final cost
+                    heap_decrease(S->Q, v, c, c);
+                else
+                    continue;
+                S->cost[v] = c;
+                S->parent[v] = u;
+                if (!ok)
+                    break;
+            }
+        }
+    }
+
+    // Leaves the open list empty for the next search
+    while (!heap_empty(S->Q))
+        heap_pop(S->Q);
+    return ok ? expanded : -1;
+}
+
+double hpa_search_cost(hpa_search S, position p)
+{
+    if (p.x < S->x0 || p.x >= S->x1 || p.y < S->y0 || p.y >= S->y1)
+        return INFINITY;
+    return S->cost[(p.y - S->y0) * S->H->side + (p.x - S->x0)];
+}
+
+void hpa_search_path(hpa_search S, grid *G, position p)
+{
+    int side = S->H->side;
+    for (int k = (p.y - S->y0) * side + (p.x - S->x0); S->parent[k] >= 0; k = S->parent[k])
+        setGridMark(G, S->x0 + k % side, S->y0 + k / side, M_PATH);
+}
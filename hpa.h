@@ -0,0 +1,118 @@
+#ifndef HPA_H
+#define HPA_H
+
+#include "tools.h"
+#include "heap.h"
+
+// Hierarchical pathfinding (HPA*): the grid is cut into square clusters, and
+// the free cells on both sides of the borders between two clusters are
+// grouped into entrances. An entrance of a few cells gets a transition in
+// its middle, a wider one a transition at each end. The abstract graph links
+// the cells of the transitions across the borders, and the ones of a
+// cluster to each other with the cost of the cheapest path inside the
+// cluster. A search on this graph, whose nodes are much fewer than the
+// cells, gives the clusters that the path crosses, and the path is refined
+// inside these clusters only. The paths are near optimal: they cross the
+// borders through the transitions only, never diagonally at a corner.
+//
+//  X, Y       = dimensions of the grid
+//  side       = side of the clusters, in cells, the last ones of a row or a
+//               column may be smaller
+//  CX, CY     = number of clusters along x and y, cluster c is the cluster
+//               c % CX of the row of clusters c / CX
+//  n          = number of abstract nodes
+//  at         = at[i] is the cell of node i, the nodes of a cluster are
+//               consecutive in the order of their cells
+//  first      = the nodes of cluster c are first[c] <= i < first[c + 1]
+//  offset     = the costs inside cluster c, with m nodes, start at
+//               intra[offset[c]]
+//  intra      = intra[offset[c] + a * m + b] is the cost from the node
+//               first[c] + a to the node first[c] + b inside cluster c, or
+//               INFINITY
+//  link_first = the nodes across the borders from node i, whose cells are
+//               neighbors of at[i], are link[link_first[i] <= j <
+//               link_first[i + 1]]
+typedef struct cluster_graph
+{
+    int X, Y;
+    int side;
+    int CX, CY;
+    int n;
+    position *at;
+    int *first;
+    long *offset;
+    double *intra;
+    int *link_first;
+    int *link;
+} *cluster_graph;
+
+// Cuts G, which must store the whole grid, into clusters of side cells and
+// computes the costs inside the clusters. The clusters are independent: the
+// processes of comm share them, a process runs its own ones on threads
+// threads, then every process receives all the costs. weight[v] is the
+// weight of a cell of value v. Returns NULL if there is not enough memory.
+cluster_graph hpa_create(const grid *G, int side, const double *weight, MPI_Comm comm, int threads);
+
+// Reads the abstract graph of G from file, which hpa_save() wrote. Returns
+// NULL if the file does not exist, holds the graph of another grid or
+// another side, or is corrupt.
+cluster_graph hpa_load(const grid *G, int side, const char *file);
+
+// Writes the abstract graph H of G to file. Returns false if it cannot.
+bool hpa_save(cluster_graph H, const grid *G, const char *file);
+
+// Frees the abstract graph H.
+void hpa_destroy(cluster_graph H);
+
+// Bytes allocated for H.
+size_t hpa_bytes(cluster_graph H);
+
+// Returns the cluster of the cell p.
+static inline int hpa_cluster(cluster_graph H, position p)
+{
+    return p.y / H->side * H->CX + p.x / H->side;
+}
+
+// Dijkstra search from a cell, restricted to the cells of its cluster.
+//
+//  H      = abstract graph of the grid
+//  G      = grid searched
+//  weight = weight[v] is the weight of a cell of value v
+//  x0, y0 = first column and row of the cluster searched
+//  x1, y1 = the cluster ends before column x1 and row y1
+//  cost   = cost[(y - y0) * side + (x - x0)] is the cost from the origin to
+//           (x,y), or INFINITY
+//  parent = parent[] is the index in cost of the previous cell of the path
+//           to (x,y), -1 for the origin
+//  Q      = open list, whose keys are the indices in cost
+typedef struct hpa_search
+{
+    cluster_graph H;
+    const grid *G;
+    const double *weight;
+    int x0, y0, x1, y1;
+    double *cost;
+    int *parent;
+    heap Q;
+} *hpa_search;
+
+// Creates a search of the clusters of H in G. Returns NULL if there is not
+// enough memory.
+hpa_search hpa_search_create(cluster_graph H, const grid *G, const double *weight);
+
+// Frees the search S.
+void hpa_search_destroy(hpa_search S);
+
+// Computes the costs from the cell s to the cells of its cluster, and
+// returns the number of cells expanded, or -1 if there is not enough memory.
+long hpa_search_from(hpa_search S, position s);
+
+// Returns the cost of the last search of S to the cell p, or INFINITY if p
+// is not in the cluster searched or cannot be reached.
+double hpa_search_cost(hpa_search S, position p);
+
+// Marks M_PATH in G the cells of the path of the last search of S from p,
+// which it must reach, back to the origin, excluded.
+void hpa_search_path(hpa_search S, grid *G, position p);
+
+#endif
@@ -0,0 +1,303 @@
+#include "jump.h"
+
+const int jump_dx[8] = {-1, 0, 1, -1, 1, -1, 0, 1};
+const int jump_dy[8] = {-1, -1, -1, 0, 0, 1, 1, 1};
+
+const char *jump_names[] = {"off", "jps", "plus"};
+
+// Returns the 64 bits of the bitset r starting at bit b.
+static inline uint64_t bits(const uint64_t *r, long b)
+{
+    long w = b >> 6;
+    int s = b & 63;
+    return s == 0 ? r[w] : (r[w] >> s) | (r[w + 1] << (64 - s));
+}
+
+// Returns true if (x,y) is a wall or outside the grid.
+static inline bool wall(jump_grid J, int x, int y)
+{
+    long b = 64 + x;
+    return (J->rows[y * J->words + (b >> 6)] >> (b & 63)) & 1;
+}
+
+// Returns true if the free cell (x,y), reached by the straight move (dx,dy),
+// has a neighbor that only a path through it reaches as cheaply.
+static bool forcedStraight(jump_grid J, int x, int y, int dx, int dy)
+{
+    if (dy == 0)
+        return (wall(J, x, y - 1) && !wall(J, x + dx, y - 1)) || (wall(J, x, y + 1) && !wall(J, x + dx, y + 1));
+    return (wall(J, x - 1, y) && !wall(J, x - 1, y + dy)) || (wall(J, x + 1, y) && !wall(J, x + 1, y + dy));
+}
+
+// Same as forcedStraight(), for the diagonal move (dx,dy).
+static bool forcedDiagonal(jump_grid J, int x, int y, int dx, int dy)
+{
+    return (wall(J, x - dx, y) && !wall(J, x - dx, y + dy)) || (wall(J, x, y - dy) && !wall(J, x + dx, y - dy));
+}
+
+// Returns the first cell after cell i of the line b, in increasing order,
+// that is a wall or whose successor on one of the lines a and c beside b is
+// forced: the first cell j such that a[j] is a wall and a[j+1] is not. *jump
+// tells which. The lines are scanned 64 cells at a time.
+static long scanUp(const uint64_t *a, const uint64_t *b, const uint64_t *c, long i, bool *jump)
+{
+    for (long p = 64 + i + 1;; p += 64)
+    {
+        uint64_t w = bits(b, p);
+        uint64_t s = w | (bits(a, p) & ~bits(a, p + 1)) | (bits(c, p) & ~bits(c, p + 1));
+        if (s != 0)
+        {
+            int k = __builtin_ctzll(s);
+            *jump = !((w >> k) & 1);
+            return p - 64 + k;
+        }
+    }
+}
+
+// Same as scanUp(), in decreasing order. The first cell of a line is a wall,
+// which stops the scan before it reads the bits before the line.
+static long scanDown(const uint64_t *a, const uint64_t *b, const uint64_t *c, long i, bool *jump)
+{
+    for (long p = 64 + i - 64;; p -= 64)
+    {
+        uint64_t w = bits(b, p);
+        uint64_t s = w | (bits(a, p) & ~bits(a, p - 1)) | (bits(c, p) & ~bits(c, p - 1));
+        if (s != 0)
+        {
+            int k = 63 - __builtin_clzll(s);
+            *jump = !((w >> k) & 1);
+            return p - 64 + k;
+        }
+    }
+}
+
+// jump() for the straight move (dx,dy), scanning the walls.
+static int jumpStraight(jump_grid J, int x, int y, int dx, int dy, position t)
+{
+    const uint64_t *lines = dy == 0 ? J->rows + (long)y * J->words : J->cols + (long)x * J->words;
+    int i = dy == 0 ? x : y;
+    int d = dx + dy;
+    bool on_line = dy == 0 ? t.y == y : t.x == x;
+    int ti = dy == 0 ? t.x : t.y;
+
+    bool jump;
+    long j = d > 0 ? scanUp(lines - J->words, lines, lines + J->words, i, &jump)
+                   : scanDown(lines - J->words, lines, lines + J->words, i, &jump);
+
+    // The destination comes before the wall, or at the latest on the jump point
+    if (on_line && (ti - i) * d > 0 && (j - ti) * d >= (jump ? 0 : 1))
+        return (ti - i) * d;
+    return jump ? (j - i) * d : 0;
+}
+
+// jump() for the diagonal move (dx,dy), scanning the walls: a cell is a jump
+// point if it has a forced neighbor or if a straight jump from it along dx or
+// dy finds one.
+static int jumpDiagonal(jump_grid J, int x, int y, int dx, int dy, position t)
+{
+    for (int k = 1;; k++)
+    {
+        x += dx;
+        y += dy;
+        if (wall(J, x, y))
+            return 0;
+        if ((x == t.x && y == t.y) || forcedDiagonal(J, x, y, dx, dy) || jumpStraight(J, x, y, dx, 0, t) > 0 ||
+            jumpStraight(J, x, y, 0, dy, t) > 0)
+            return k;
+    }
+}
+
+// Returns the number of moves from (x,y) in direction d before the next jump
+// point or wall, from the precomputed distances.
+static inline int reach(jump_grid J, int x, int y, int d)
+{
+    int n = J->dist[8 * ((long)y * J->X + x) + d];
+    return n > 0 ? n : -n;
+}
+
+// jump() with the precomputed distances, which ignore the destination. A
+// diagonal move towards the destination stops on its row or column if a
+// straight move reaches it from there, as jumpDiagonal() does.
+static int jumpPlus(jump_grid J, int x, int y, int d, position t)
+{
+    int dx = jump_dx[d], dy = jump_dy[d];
+    int n = J->dist[8 * ((long)y * J->X + x) + d];
+    int r = n > 0 ? n : -n;
+    int tx = (t.x - x) * dx, ty = (t.y - y) * dy;
+
+    if (dy == 0 && t.y == y && tx > 0 && tx <= r)
+        return tx;
+    if (dx == 0 && t.x == x && ty > 0 && ty <= r)
+        return ty;
+    if (dx != 0 && dy != 0 && tx > 0 && ty > 0)
+    {
+        int m = tx < ty ? tx : ty;
+        int cx = x + m * dx, cy = y + m * dy;
+        if (m <= r && (tx == ty || (tx < ty && ty - m <= reach(J, cx, cy, jump_direction(0, dy))) ||
+                       (ty < tx && tx - m <= reach(J, cx, cy, jump_direction(dx, 0)))))
+            return m;
+    }
+    return n > 0 ? n : 0;
+}
+
+int jump(jump_grid J, int x, int y, int d, position t)
+{
+    if (J->dist != NULL)
+        return jumpPlus(J, x, y, d, t);
+    if (jump_dx[d] != 0 && jump_dy[d] != 0)
+        return jumpDiagonal(J, x, y, jump_dx[d], jump_dy[d], t);
+    return jumpStraight(J, x, y, jump_dx[d], jump_dy[d], t);
+}
+
+int jump_directions(jump_grid J, int x, int y, int dx, int dy, int dirs[8])
+{
+    int n = 0;
+    if (dx == 0 && dy == 0)
+    {
+        for (int d = 0; d < 8; d++)
+            dirs[n++] = d;
+    }
+    else if (dy == 0)
+    {
+        dirs[n++] = jump_direction(dx, 0);
+        if (wall(J, x, y - 1) && !wall(J, x + dx, y - 1))
+            dirs[n++] = jump_direction(dx, -1);
+        if (wall(J, x, y + 1) && !wall(J, x + dx, y + 1))
+            dirs[n++] = jump_direction(dx, 1);
+    }
+    else if (dx == 0)
+    {
+        dirs[n++] = jump_direction(0, dy);
+        if (wall(J, x - 1, y) && !wall(J, x - 1, y + dy))
+            dirs[n++] = jump_direction(-1, dy);
+        if (wall(J, x + 1, y) && !wall(J, x + 1, y + dy))
+            dirs[n++] = jump_direction(1, dy);
+    }
+    else
+    {
+        dirs[n++] = jump_direction(dx, 0);
+        dirs[n++] = jump_direction(0, dy);
+        dirs[n++] = jump_direction(dx, dy);
+        if (wall(J, x - dx, y) && !wall(J, x - dx, y + dy))
+            dirs[n++] = jump_direction(-dx, dy);
+        if (wall(J, x, y - dy) && !wall(J, x + dx, y - dy))
+            dirs[n++] = jump_direction(dx, -dy);
+    }
+    return n;
+}
+
+// Returns the entry d of the table of the cell (x,y), from the entries of
+// its successor in direction d. The walls inside the grid have entries too,
+// as the origin of a search may be one.
+static int32_t distance(jump_grid J, int x, int y, int d)
+{
+    int dx = jump_dx[d], dy = jump_dy[d];
+    int nx = x + dx, ny = y + dy;
+    if (x == 0 || y == 0 || x == J->X - 1 || y == J->Y - 1 || wall(J, nx, ny))
+        return 0;
+
+    const int32_t *n = J->dist + 8 * ((long)ny * J->X + nx);
+    bool jump_point = dx != 0 && dy != 0 ? forcedDiagonal(J, nx, ny, dx, dy) || n[jump_direction(dx, 0)] > 0 ||
+                                               n[jump_direction(0, dy)] > 0
+                                         : forcedStraight(J, nx, ny, dx, dy);
+    if (jump_point)
+        return 1;
+    return n[d] > 0 ? n[d] + 1 : n[d] - 1;
+}
+
+// Fills the table of the jump distances. The entries of a cell in direction
+// d come from the ones of its successor, so the cells are visited from the
+// end of the moves, the straight directions first as the diagonal ones
+// depend on them.
+static void fillDistances(jump_grid J)
+{
+    static const int order[8] = {1, 3, 4, 6, 0, 2, 5, 7};
+    for (int i = 0; i < 8; i++)
+    {
+        int d = order[i];
+        int dx = jump_dx[d], dy = jump_dy[d];
+        for (int j = 0; j < J->Y; j++)
+        {
+            int y = dy > 0 ? J->Y - 1 - j : j;
+            for (int k = 0; k < J->X; k++)
+            {
+                int x = dx > 0 ? J->X - 1 - k : k;
+                J->dist[8 * ((long)y * J->X + x) + d] = distance(J, x, y, d);
+            }
+        }
+    }
+}
+
+bool jump_uniform(const grid *G)
+{
+    for (int y = 0; y < G->Y; y++)
+        for (int x = 0; x < G->X; x++)
+            if (gridValue(G, x, y) != V_FREE && gridValue(G, x, y) != V_WALL)
+                return false;
+    return true;
+}
+
+jump_grid jump_create(const grid *G, jump_kind kind)
+{
+    jump_grid J = malloc(sizeof(struct jump_grid));
+    if (J == NULL)
+        return NULL;
+    J->X = G->X;
+    J->Y = G->Y;
+    J->words = ((G->X > G->Y ? G->X : G->Y) + 64) / 64 + 2; // a word of walls before, at least one after
+    J->rows = malloc(J->Y * J->words * sizeof(uint64_t));
+    J->cols = malloc(J->X * J->words * sizeof(uint64_t));
+    J->dist = kind == JUMP_PLUS ? malloc(8 * (size_t)J->X * J->Y * sizeof(int32_t)) : NULL;
+    if (J->rows == NULL || J->cols == NULL || (kind == JUMP_PLUS && J->dist == NULL))
+    {
+        jump_destroy(J);
+        return NULL;
+    }
+
+    memset(J->rows, 0xff, J->Y * J->words * sizeof(uint64_t));
+    memset(J->cols, 0xff, J->X * J->words * sizeof(uint64_t));
+    for (int y = 0; y < G->Y; y++)
+    {
+        for (int x = 0; x < G->X; x++)
+        {
+            if (gridValue(G, x, y) == V_WALL)
+                continue;
+            long bx = 64 + x, by = 64 + y;
+            J->rows[y * J->words + (bx >> 6)] &= ~(1ULL << (bx & 63));
+            J->cols[x * J->words + (by >> 6)] &= ~(1ULL << (by & 63));
+        }
+    }
+
+    if (kind == JUMP_PLUS)
+        fillDistances(J);
+    return J;
+}
+
+void jump_destroy(jump_grid J)
+{
+    free(J->rows);
+    free(J->cols);
+    free(J->dist);
+    free(J);
+}
+
+size_t jump_bytes(jump_grid J)
+{
+    size_t bytes = (size_t)(J->X + J->Y) * J->words * sizeof(uint64_t);
+    if (J->dist != NULL)
+        bytes += 8 * (size_t)J->X * J->Y * sizeof(int32_t);
+    return bytes;
+}
+
+bool jump_parse(const char *name, jump_kind *kind)
+{
+    for (int k = JUMP_OFF; k <= JUMP_PLUS; k++)
+    {
+        if (strcmp(name, jump_names[k]) == 0)
+        {
+            *kind = k;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,79 @@
+#ifndef JUMP_H
+#define JUMP_H
+
+#include "tools.h"
+
+// Jump Point Search on grids whose cells are all V_FREE or V_WALL, where
+// every move costs the same: instead of its 8 neighbors, a node generates the
+// next jump points in the directions that cannot be reached by a path as
+// cheap avoiding it, skipping the symmetric paths of the open regions.
+// Diagonal moves may cut corners, as in the other engines.
+typedef enum
+{
+    JUMP_OFF,  // plain A*
+    JUMP_SCAN, // jump points found by scanning the walls, 64 cells at a time
+    JUMP_PLUS, // jump distances precomputed for every cell and direction (JPS+)
+} jump_kind;
+
+// Walls of a grid for the jumps.
+//
+//  X, Y  = dimensions of the grid
+//  words = number of 64 bit words of a row of rows, or a column of cols
+//  rows  = rows + y * words is the bitset of row y: bit 64 + x is set if
+//          (x,y) is a wall, as are the bits of the cells outside the grid
+//  cols  = the same for the columns, bit 64 + y of column x
+//  dist  = JUMP_PLUS only: dist[8 * (y * X + x) + d] is the number of moves
+//          from (x,y) in direction d to the next jump point if positive, or
+//          the opposite of the number of moves before a wall, for the cells
+//          inside the border
+typedef struct jump_grid
+{
+    int X, Y;
+    long words;
+    uint64_t *rows;
+    uint64_t *cols;
+    int32_t *dist;
+} *jump_grid;
+
+// The 8 directions of the moves, row by row from the top left.
+extern const int jump_dx[8], jump_dy[8];
+
+// Returns true if all the cells of G are V_FREE or V_WALL. G must store the
+// whole grid.
+bool jump_uniform(const grid *G);
+
+// Builds the walls of G, and for JUMP_PLUS the table of the jump distances.
+// Returns NULL if there is not enough memory.
+jump_grid jump_create(const grid *G, jump_kind kind);
+
+// Frees the walls and the table of J.
+void jump_destroy(jump_grid J);
+
+// Bytes allocated for J.
+size_t jump_bytes(jump_grid J);
+
+// Stores in dirs the directions of the successors of the node (x,y) reached
+// by a move in direction (dx,dy), all of them for (0,0), and returns their
+// number.
+int jump_directions(jump_grid J, int x, int y, int dx, int dy, int dirs[8]);
+
+// Returns the number of moves from the cell (x,y), free or the origin of the
+// search, in direction d to the next jump point, or to t if t comes first, or
+// 0 if a wall comes first.
+int jump(jump_grid J, int x, int y, int d, position t);
+
+// Returns the index d of the move (dx,dy) != (0,0): jump_dx[d] = dx and
+// jump_dy[d] = dy.
+static inline int jump_direction(int dx, int dy)
+{
+    int k = (dy + 1) * 3 + dx + 1;
+    return k < 4 ? k : k - 1;
+}
+
+// Names of the kinds for the command line.
+extern const char *jump_names[];
+
+// Parses the name of a kind, returns false if unknown.
+bool jump_parse(const char *name, jump_kind *kind);
+
+#endif
@@ -0,0 +1,250 @@
+#include "landmark.h"
+#include "heap.h"
+#include <pthread.h>
+
+// Header of a landmark file, followed by the K cells of the landmarks and
+// the K tables, row by row without the padding of the grid rows.
+typedef struct
+{
+    char magic[8];
+    int X, Y, K;
+    uint64_t grid_hash; // of the values of the grid
+} landmark_header;
+
+static const char magic[8] = "ALT v1";
+
+// Allocates the landmarks of G with their weights in tenths, NULL if there
+// is not enough memory.
+static landmarks allocLandmarks(const grid *G, int K, const double *weight)
+{
+    landmarks L = malloc(sizeof(struct landmarks));
+    if (L == NULL)
+        return NULL;
+    L->K = K;
+    L->size = gridSize(G);
+    L->at = malloc(K * sizeof(position));
+    L->dist = malloc(K * L->size * sizeof(uint32_t));
+    if (L->at == NULL || L->dist == NULL)
+    {
+        landmark_destroy(L);
+        return NULL;
+    }
+    for (int v = 0; v < LANDMARK_VALUES; v++)
+        L->w[v] = v == V_WALL ? 0 : (uint32_t)lround(weight[v] * 10);
+    return L;
+}
+
+// Returns the free cell of G closest to the border on the way from (x,y) to
+// the center of G, or any free cell if there is none, or (-1,-1).
+static position freeCellTowardsCenter(const grid *G, int x, int y)
+{
+    int cx = G->X / 2, cy = G->Y / 2;
+    int n = abs(cx - x) > abs(cy - y) ? abs(cx - x) : abs(cy - y);
+    for (int i = 0; i <= n; i++)
+    {
+        int px = x + (n == 0 ? 0 : (cx - x) * i / n);
+        int py = y + (n == 0 ? 0 : (cy - y) * i / n);
+        if (gridValue(G, px, py) != V_WALL)
+            return (position){px, py};
+    }
+    for (int py = 1; py < G->Y - 1; py++)
+        for (int px = 1; px < G->X - 1; px++)
+            if (gridValue(G, px, py) != V_WALL)
+                return (position){px, py};
+    return (position){-1, -1};
+}
+
+// Places the K landmarks at regular intervals along the border: the lower
+// bounds are the tightest for the paths heading towards a landmark, or away
+// from it.
+static void placeLandmarks(const grid *G, landmarks L)
+{
+    int W = G->X - 2, H = G->Y - 2; // inside of the border
+    long perimeter = 2L * (W + H);
+    for (int l = 0; l < L->K; l++)
+    {
+        long p = (2 * l + 1) * perimeter / (2 * L->K);
+        int x, y;
+        if (p < W)
+            x = 1 + p, y = 1;
+        else if ((p -= W) < H)
+            x = W, y = 1 + p;
+        else if ((p -= H) < W)
+            x = W - p, y = H;
+        else
+            x = 1, y = H - (p - W);
+        L->at[l] = freeCellTowardsCenter(G, x, y);
+    }
+}
+
+// Fills the table of landmark l with a Dijkstra search from it. Returns
+// false if there is not enough memory.
+static bool dijkstra(const grid *G, landmarks L, int l)
+{
+    uint32_t *d = L->dist + l * L->size;
+    for (size_t k = 0; k < L->size; k++)
+        d[k] = LANDMARK_INF;
+    position s = L->at[l];
+    if (s.x < 0)
+        return true;
+
+    heap Q = heap_create(1024, L->size);
+    int k = gridIndex(G, s.x, s.y);
+    d[k] = 0;
+    bool ok = !heap_add(Q, 0, 0, k, k);
+    while (ok && !heap_empty(Q))
+    {
+        int u = heap_pop(Q); // ids are the keys: the indices of the cells
+        int ux = u % G->stride + G->x0, uy = u / G->stride + G->y0;
+        for (int y = -1; y <= 1 && ok; y++)
+        {
+            for (int x = -1; x <= 1; x++)
+            {
+                int v = gridIndex(G, ux + x, uy + y);
+                if ((x == 0 && y == 0) || G->value[v] == V_WALL)
+                    continue;
+                uint32_t c = d[u] + L->w[G->value[v]];
+                if (d[v] == LANDMARK_INF)
+                    ok = !heap_add(Q, c, c, v, v);
+                else if (c < d[v]) // v is still open, a closed cell has its final cost
+                    heap_decrease(Q, v, c, c);
+                else
+                    continue;
+                d[v] = c;
+                if (!ok)
+                    break;
+            }
+        }
+    }
+    heap_destroy(Q);
+    return ok;
+}
+
+// Landmarks computed by a thread: first, first + step, ...
+typedef struct
+{
+    const grid *G;
+    landmarks L;
+    int first, step;
+    bool ok;
+    bool started; // whether the job runs on its own thread
+    pthread_t thread;
+} landmark_job;
+
+static void *runJob(void *arg)
+{
+    landmark_job *j = arg;
+    j->ok = true;
+    for (int l = j->first; l < j->L->K; l += j->step)
+        j->ok &= dijkstra(j->G, j->L, l);
+    return NULL;
+}
+
+landmarks landmark_create(const grid *G, int K, const double *weight, MPI_Comm comm, int threads)
+{
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    landmarks L = allocLandmarks(G, K, weight);
+    int ok = L != NULL;
+    if (ok)
+    {
+        placeLandmarks(G, L);
+
+        // Landmark l is computed by process l % size, and by its thread l / size % threads
+        landmark_job *J = malloc(threads * sizeof(landmark_job));
+        for (int t = 0; t < threads; t++)
+            J[t] = (landmark_job){G, L, rank + t * size, size * threads, true, false};
+        for (int t = 1; t < threads; t++)
+            J[t].started = pthread_create(&J[t].thread, NULL, runJob, &J[t]) == 0;
+        runJob(&J[0]);
+        for (int t = 0; t < threads; t++)
+        {
+            if (J[t].started)
+                pthread_join(J[t].thread, NULL);
+            else if (t > 0)
+                runJob(&J[t]); // no thread left, this one does the job
+            ok &= J[t].ok;
+        }
+        free(J);
+    }
+
+    MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_LAND, comm);
+    if (!ok)
+    {
+        if (L != NULL)
+            landmark_destroy(L);
+        return NULL;
+    }
+
+    // Every process receives all the tables, by chunks whose count fits in an int
+    for (int l = 0; l < K; l++)
+        for (size_t k = 0; k < L->size; k += INT_MAX)
+            MPI_Bcast(L->dist + l * L->size + k, L->size - k < INT_MAX ? L->size - k : INT_MAX, MPI_UINT32_T,
+                      l % size, comm);
+    return L;
+}
+
+landmarks landmark_load(const grid *G, int K, const double *weight, const char *file)
+{
+    FILE *f = fopen(file, "rb");
+    if (f == NULL)
+        return NULL;
+
+    landmark_header h;
+    landmarks L = NULL;
+    if (fread(&h, sizeof(h), 1, f) == 1 && memcmp(h.magic, magic, sizeof(magic)) == 0 && h.X == G->X &&
+        h.Y == G->Y && h.K == K && h.grid_hash == gridHash(G))
+        L = allocLandmarks(G, K, weight);
+
+    bool ok = L != NULL && fread(L->at, sizeof(position), K, f) == (size_t)K;
+    for (int l = 0; l < K && ok; l++)
+    {
+        uint32_t *d = L->dist + l * L->size;
+        for (int y = 0; y < G->Y && ok; y++)
+            ok = fread(d + gridIndex(G, 0, y), sizeof(uint32_t), G->X, f) == (size_t)G->X;
+    }
+    fclose(f);
+    if (!ok && L != NULL)
+    {
+        landmark_destroy(L);
+        L = NULL;
+    }
+    return L;
+}
+
+bool landmark_save(landmarks L, const grid *G, const char *file)
+{
+    FILE *f = fopen(file, "wb");
+    if (f == NULL)
+        return false;
+
+    landmark_header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, magic, sizeof(magic));
+    h.X = G->X;
+    h.Y = G->Y;
+    h.K = L->K;
+    h.grid_hash = gridHash(G);
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1 && fwrite(L->at, sizeof(position), L->K, f) == (size_t)L->K;
+    for (int l = 0; l < L->K && ok; l++)
+    {
+        const uint32_t *d = L->dist + l * L->size;
+        for (int y = 0; y < G->Y && ok; y++)
+            ok = fwrite(d + gridIndex(G, 0, y), sizeof(uint32_t), G->X, f) == (size_t)G->X;
+    }
+    return fclose(f) == 0 && ok;
+}
+
+void landmark_destroy(landmarks L)
+{
+    free(L->at);
+    free(L->dist);
+    free(L);
+}
+
+size_t landmark_bytes(landmarks L)
+{
+    return L->K * (sizeof(position) + L->size * sizeof(uint32_t));
+}
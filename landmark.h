@@ -0,0 +1,78 @@
+#ifndef LANDMARK_H
+#define LANDMARK_H
+
+#include "tools.h"
+
+// Number of cell values (V_FREE to V_TUNNEL)
+#define LANDMARK_VALUES (V_TUNNEL + 1)
+
+// Distance of the cells that a landmark cannot reach
+#define LANDMARK_INF UINT32_MAX
+
+// Landmarks (ALT): the exact costs from a few cells to all the cells of a
+// grid, which bound the cost between any two cells by the triangle
+// inequality. A path from u to v pays the weight of every cell it enters,
+// so the cost from v to u is the cost from u to v plus w[u] minus w[v]: the
+// costs from the landmarks give the costs to them too.
+//
+//  K      = number of landmarks
+//  at     = at[l] is the cell of landmark l
+//  size   = number of entries of a table, gridSize() of the grid
+//  dist   = dist[l * size + gridIndex(x,y)] is the cost from landmark l to
+//           (x,y), or LANDMARK_INF
+//  w      = w[v] is the weight of a cell of value v
+//
+// Costs are kept in tenths of the weights, on 32 bits: the weights are
+// multiples of 0.1, so the sums are exact, up to costs of 4e8.
+typedef struct landmarks
+{
+    int K;
+    position *at;
+    size_t size;
+    uint32_t *dist;
+    uint32_t w[LANDMARK_VALUES];
+} *landmarks;
+
+// Selects K landmarks spread along the border of G, which must store the
+// whole grid, and computes their tables with one Dijkstra search each. The
+// processes of comm share the searches, a process runs its own ones on
+// threads threads, then every process receives all the tables. weight[v] is
+// the weight of a cell of value v. Returns NULL if there is not enough
+// memory.
+landmarks landmark_create(const grid *G, int K, const double *weight, MPI_Comm comm, int threads);
+
+// Reads the landmarks of G from file, which landmark_save() wrote. Returns
+// NULL if the file does not exist or holds the landmarks of another grid.
+landmarks landmark_load(const grid *G, int K, const double *weight, const char *file);
+
+// Writes the landmarks L of G to file. Returns false if it cannot.
+bool landmark_save(landmarks L, const grid *G, const char *file);
+
+// Frees the landmarks L.
+void landmark_destroy(landmarks L);
+
+// Bytes allocated for L.
+size_t landmark_bytes(landmarks L);
+
+// Returns a lower bound of the cost from s to t, two cells of G.
+static inline double landmark_bound(landmarks L, const grid *G, position s, position t)
+{
+    size_t ks = gridIndex(G, s.x, s.y), kt = gridIndex(G, t.x, t.y);
+    int64_t dw = (int64_t)L->w[G->value[kt]] - L->w[G->value[ks]];
+    int64_t best = 0;
+    for (int l = 0; l < L->K; l++)
+    {
+        const uint32_t *d = L->dist + l * L->size;
+        if (d[ks] == LANDMARK_INF || d[kt] == LANDMARK_INF)
+            continue;
+        int64_t b = (int64_t)d[kt] - d[ks]; // cost(l,t) - cost(l,s)
+        if (b > best)
+            best = b;
+        b = (int64_t)d[ks] - d[kt] + dw; // cost(s,l) - cost(t,l)
+        if (b > best)
+            best = b;
+    }
+    return best / 10.0;
+}
+
+#endif
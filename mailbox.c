@@ -0,0 +1,115 @@
+#define _POSIX_C_SOURCE 200809L // clock_gettime()
+#include "mailbox.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <mpi.h>
+
+// Returns an empty mail owned by m, reusing a mail read by its destination
+// if possible. Exits if there is no memory left.
+static mail *allocMail(mailbox m)
+{
+    if (m->spare == NULL)
+        m->spare = inbox_take(&m->returns[m->self]);
+
+    mail *f = m->spare;
+    if (f != NULL)
+        m->spare = f->next;
+    else if ((f = malloc(sizeof(mail) + m->batch * m->size)) == NULL)
+    {
+        fprintf(stderr, "Mailbox cannot expand anymore\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    f->owner = m->self;
+    f->n = 0;
+    return f;
+}
+
+// Frees the list of mails l.
+static void freeMails(mail *l)
+{
+    while (l != NULL)
+    {
+        mail *next = l->next;
+        free(l);
+        l = next;
+    }
+}
+
+void mail_return(inbox *returns, mail *l)
+{
+    while (l != NULL)
+    {
+        mail *next = l->next;
+        inbox_put(&returns[l->owner], l);
+        l = next;
+    }
+}
+
+mailbox mailbox_create(int ndst, int batch, size_t size, inbox *boxes, inbox *returns, int self)
+{
+    mailbox m = malloc(sizeof(struct mailbox));
+    m->ndst = ndst;
+    m->batch = batch;
+    m->size = size;
+    m->boxes = boxes;
+    m->returns = returns;
+    m->self = self;
+    m->spare = NULL;
+    m->fill = malloc(ndst * sizeof(mail *));
+    m->since = malloc(ndst * sizeof(double));
+    for (int d = 0; d < ndst; d++)
+        m->fill[d] = allocMail(m);
+    m->oldest = INFINITY;
+    m->pending = m->mails = m->objects = 0;
+    return m;
+}
+
+void mailbox_destroy(mailbox m)
+{
+    for (int d = 0; d < m->ndst; d++)
+        free(m->fill[d]);
+    freeMails(m->spare);
+    freeMails(inbox_take(&m->returns[m->self]));
+    free(m->fill);
+    free(m->since);
+    free(m);
+}
+
+void mailbox_flush(mailbox m, int d)
+{
+    mail *f = m->fill[d];
+    if (f->n == 0)
+        return;
+
+    m->mails++;
+    m->objects += f->n;
+    m->pending -= f->n;
+    inbox_put(&m->boxes[d], f);
+    m->fill[d] = allocMail(m);
+}
+
+void mailbox_flush_before(mailbox m, double t)
+{
+    if (m->oldest >= t)
+        return;
+
+    m->oldest = INFINITY;
+    for (int d = 0; d < m->ndst; d++)
+    {
+        if (m->fill[d]->n == 0)
+            continue;
+        if (m->since[d] < t)
+            mailbox_flush(m, d);
+        else if (m->since[d] < m->oldest)
+            m->oldest = m->since[d];
+    }
+}
+
+double mailbox_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
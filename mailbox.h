@@ -0,0 +1,117 @@
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <string.h>
+
+// A batch of objects passed from a thread to another one. The objects start
+// 16 bytes into the mail, which suits any object made of ints and doubles.
+typedef struct mail
+{
+    struct mail *next; // next mail of the list it belongs to
+    int owner;         // thread that allocated the mail, which reuses it once read
+    int n;             // number of objects
+    char data[];
+} mail;
+
+// A list of mails that any thread can add mails to and from which a single
+// thread takes all the mails at once, without locks: as mails are never
+// removed one by one, the compare-and-swap of inbox_put() is immune to the
+// ABA problem. Each inbox fills its own cache line.
+typedef struct
+{
+    _Alignas(64) _Atomic(mail *) head;
+} inbox;
+
+// Adds mail m to inbox b.
+static inline void inbox_put(inbox *b, mail *m)
+{
+    m->next = atomic_load_explicit(&b->head, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&b->head, &m->next, m, memory_order_release,
+                                                  memory_order_relaxed))
+        ;
+}
+
+// Removes all the mails of inbox b and returns them as a list, most recent
+// first, or NULL if b is empty.
+static inline mail *inbox_take(inbox *b)
+{
+    if (atomic_load_explicit(&b->head, memory_order_relaxed) == NULL)
+        return NULL;
+    return atomic_exchange_explicit(&b->head, NULL, memory_order_acquire);
+}
+
+// Gives the list of mails l, once read, back to their owners: mail m goes to
+// inbox returns[m->owner].
+void mail_return(inbox *returns, mail *l);
+
+// Outgoing mails of a thread, aggregated per destination thread, as outbox
+// does for processes.
+//
+//  ndst    = number of destinations
+//  batch   = number of objects of a full mail
+//  size    = size in bytes of an object
+//  boxes   = boxes[d] is the inbox of destination d
+//  returns = returns[t] is the inbox of the mails read that thread t owns
+//  self    = index of the thread in returns
+//  fill    = fill[d] is the mail being filled for destination d
+//  since   = since[d] is the mailbox_time() of the first object of fill[d]
+//  oldest  = lowest since[d] of the non-empty mails, or +inf
+//  spare   = list of mails ready to be filled again
+//
+// A mail is sent when it is full, when it is older than a time budget, or
+// when the thread runs out of work. Read mails come back to their owner
+// through returns[self], so that mails are only allocated while the number
+// of mails in flight grows.
+typedef struct mailbox
+{
+    int ndst, batch;
+    size_t size;
+    inbox *boxes, *returns;
+    int self;
+    mail **fill;
+    double *since;
+    double oldest;
+    mail *spare;
+    long pending; // number of objects in the mails, not sent yet
+    long mails;   // number of mails sent
+    long objects; // number of objects sent
+} *mailbox;
+
+// Creates the outgoing mails of thread self to ndst destinations, sending
+// mails of at most batch>0 objects of the given size.
+mailbox mailbox_create(int ndst, int batch, size_t size, inbox *boxes, inbox *returns, int self);
+
+// Frees the mails of mailbox m, including the ones returned to it. The
+// other threads must not hold any mail of m anymore.
+void mailbox_destroy(mailbox m);
+
+// Sends the objects of the mail of destination d, if any.
+void mailbox_flush(mailbox m, int d);
+
+// Sends the mails whose first object was pushed before time t
+// (mailbox_time()), or all the non-empty mails if t is +inf.
+void mailbox_flush_before(mailbox m, double t);
+
+// Returns the current time in seconds, which any thread can read.
+double mailbox_time(void);
+
+// Copies object obj into the mail of destination d, sending the mail if it
+// becomes full.
+static inline void mailbox_push(mailbox m, int d, const void *obj)
+{
+    mail *f = m->fill[d];
+    if (f->n == 0)
+    {
+        m->since[d] = mailbox_time();
+        if (m->since[d] < m->oldest)
+            m->oldest = m->since[d];
+    }
+    memcpy(f->data + f->n * m->size, obj, m->size);
+    m->pending++;
+    if (++f->n == m->batch)
+        mailbox_flush(m, d);
+}
+
+#endif
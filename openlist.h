@@ -0,0 +1,88 @@
+#ifndef OPENLIST_H
+#define OPENLIST_H
+
+#include "heap.h"
+#include "bucket.h"
+
+// Implementations of the open list of the search engines, selected on the
+// command line.
+typedef enum
+{
+    OL_HEAP,   // d-ary heap, exact order of the scores
+    OL_BUCKET, // bucket queue, scores quantized by a bucket width
+} openlist_kind;
+
+// Open list of a search: a thin wrapper that dispatches every operation to
+// the selected implementation. The switch is inlined in the engines, where
+// it is perfectly predicted.
+typedef struct
+{
+    openlist_kind kind;
+    heap h;
+    bucket b;
+} openlist;
+
+// Creates an open list of the given kind that can hold k>0 nodes before
+// growing, with keys in [0,nkeys[. delta is the width of the buckets of
+// OL_BUCKET.
+static inline openlist openlist_create(openlist_kind kind, int k, size_t nkeys, double delta)
+{
+    openlist Q = {kind, NULL, NULL};
+    if (kind == OL_BUCKET)
+        Q.b = bucket_create(k, nkeys, delta);
+    else
+        Q.h = heap_create(k, nkeys);
+    return Q;
+}
+
+static inline void openlist_destroy(openlist Q)
+{
+    if (Q.kind == OL_BUCKET)
+        bucket_destroy(Q.b);
+    else
+        heap_destroy(Q.h);
+}
+
+static inline int openlist_empty(openlist Q)
+{
+    return Q.kind == OL_BUCKET ? bucket_empty(Q.b) : heap_empty(Q.h);
+}
+
+// Returns true if there is not enough space.
+static inline bool openlist_add(openlist Q, double score, double cost, size_t k, int id)
+{
+    return Q.kind == OL_BUCKET ? bucket_add(Q.b, score, cost, k, id) : heap_add(Q.h, score, cost, k, id);
+}
+
+static inline int openlist_get(openlist Q, size_t k)
+{
+    return Q.kind == OL_BUCKET ? bucket_get(Q.b, k) : heap_get(Q.h, k);
+}
+
+// Returns true if there is not enough space.
+static inline bool openlist_decrease(openlist Q, size_t k, double score, double cost)
+{
+    if (Q.kind == OL_BUCKET)
+        return bucket_decrease(Q.b, k, score, cost);
+    heap_decrease(Q.h, k, score, cost);
+    return false;
+}
+
+// Returns a lower bound of the scores stored in Q, +inf if Q is empty.
+static inline double openlist_min_score(openlist Q)
+{
+    return Q.kind == OL_BUCKET ? bucket_min_score(Q.b) : heap_top_score(Q.h);
+}
+
+// Number of nodes in Q.
+static inline long openlist_size(openlist Q)
+{
+    return Q.kind == OL_BUCKET ? Q.b->n : Q.h->n;
+}
+
+static inline int openlist_pop(openlist Q)
+{
+    return Q.kind == OL_BUCKET ? bucket_pop(Q.b) : heap_pop(Q.h);
+}
+
+#endif
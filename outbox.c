@@ -0,0 +1,144 @@
+#include "outbox.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define INIT_BUFFERS 16 // initial capacity of the flight and spare arrays
+
+// Allocates a buffer of o->batch objects, exits if there is no memory left.
+static char *allocBuffer(outbox o)
+{
+    char *buf = malloc(o->batch * o->size);
+    if (buf == NULL)
+    {
+        fprintf(stderr, "Outbox cannot expand anymore\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    return buf;
+}
+
+outbox outbox_create(MPI_Comm comm, int batch, size_t size, MPI_Datatype dt, int tag)
+{
+    outbox o = malloc(sizeof(struct outbox));
+    MPI_Comm_size(comm, &o->ndst);
+    o->batch = batch;
+    o->size = size;
+    o->dt = dt;
+    o->tag = tag;
+    o->comm = comm;
+    o->fill = malloc(o->ndst * sizeof(char *));
+    o->n = calloc(o->ndst, sizeof(int));
+    o->since = malloc(o->ndst * sizeof(double));
+    o->sent = calloc(o->ndst, sizeof(long));
+    for (int d = 0; d < o->ndst; d++)
+        o->fill[d] = allocBuffer(o);
+    o->oldest = INFINITY;
+    o->maxbuf = INIT_BUFFERS;
+    o->flight = malloc(o->maxbuf * sizeof(char *));
+    o->req = malloc(o->maxbuf * sizeof(MPI_Request));
+    o->spare = malloc(o->maxbuf * sizeof(char *));
+    o->nflight = o->nspare = 0;
+    o->pending = o->messages = o->objects = 0;
+    return o;
+}
+
+void outbox_destroy(outbox o)
+{
+    for (int d = 0; d < o->ndst; d++)
+        free(o->fill[d]);
+    for (int i = 0; i < o->nflight; i++)
+        free(o->flight[i]);
+    for (int i = 0; i < o->nspare; i++)
+        free(o->spare[i]);
+    free(o->fill);
+    free(o->n);
+    free(o->since);
+    free(o->sent);
+    free(o->flight);
+    free(o->req);
+    free(o->spare);
+    free(o);
+}
+
+// Moves the buffers whose send has completed from flight to spare.
+static void completeSends(outbox o)
+{
+    if (o->nflight == 0)
+        return;
+
+    int ndone, done[o->nflight];
+    MPI_Testsome(o->nflight, o->req, &ndone, done, MPI_STATUSES_IGNORE);
+    if (ndone == MPI_UNDEFINED || ndone == 0)
+        return;
+
+    for (int i = 0; i < ndone; i++)
+    {
+        o->spare[o->nspare++] = o->flight[done[i]];
+        o->flight[done[i]] = NULL;
+    }
+
+    // compact the buffers still in flight
+    int k = 0;
+    for (int i = 0; i < o->nflight; i++)
+        if (o->flight[i] != NULL)
+        {
+            o->flight[k] = o->flight[i];
+            o->req[k++] = o->req[i];
+        }
+    o->nflight = k;
+}
+
+void outbox_flush(outbox o, int d)
+{
+    if (o->n[d] == 0)
+        return;
+
+    if (o->nflight == o->maxbuf)
+    {
+        o->maxbuf *= 2;
+        o->flight = realloc(o->flight, o->maxbuf * sizeof(char *));
+        o->req = realloc(o->req, o->maxbuf * sizeof(MPI_Request));
+        o->spare = realloc(o->spare, o->maxbuf * sizeof(char *));
+        if (o->flight == NULL || o->req == NULL || o->spare == NULL)
+        {
+            fprintf(stderr, "Outbox cannot expand anymore\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+    MPI_Isend(o->fill[d], o->n[d], o->dt, d, o->tag, o->comm, &o->req[o->nflight]);
+    o->flight[o->nflight++] = o->fill[d];
+    o->messages++;
+    o->objects += o->n[d];
+    o->sent[d] += o->n[d];
+    o->pending -= o->n[d];
+    o->n[d] = 0;
+
+    // reuse a buffer whose send completed, or allocate a new one
+    if (o->nspare == 0)
+        completeSends(o);
+    o->fill[d] = o->nspare > 0 ? o->spare[--o->nspare] : allocBuffer(o);
+}
+
+void outbox_flush_before(outbox o, double t)
+{
+    if (o->oldest >= t)
+        return;
+
+    o->oldest = INFINITY;
+    for (int d = 0; d < o->ndst; d++)
+    {
+        if (o->n[d] == 0)
+            continue;
+        if (o->since[d] < t)
+            outbox_flush(o, d);
+        else if (o->since[d] < o->oldest)
+            o->oldest = o->since[d];
+    }
+}
+
+bool outbox_done(outbox o)
+{
+    completeSends(o);
+    return o->nflight == 0;
+}
@@ -0,0 +1,88 @@
+#ifndef OUTBOX_H
+#define OUTBOX_H
+
+#include <stdbool.h>
+#include <string.h>
+#include <mpi.h>
+
+// Outgoing messages of a process, aggregated per destination.
+//
+//  ndst    = number of destinations (ranks of comm)
+//  batch   = number of objects of a full message
+//  size    = size in bytes of an object
+//  dt      = MPI datatype of an object
+//  tag     = tag of the messages
+//  comm    = communicator of the messages
+//  fill    = fill[d] is the buffer being filled for destination d
+//  n       = n[d] is the number of objects in fill[d]
+//  since   = since[d] is the MPI_Wtime() of the first object of fill[d]
+//  oldest  = lowest since[d] of the non-empty buffers, or +inf
+//  flight  = buffers whose send may not have completed yet
+//  req     = req[i] is the request of the send of flight[i]
+//  nflight = number of buffers in flight
+//  spare   = buffers whose send completed, ready to be filled again
+//  nspare  = number of spare buffers
+//  maxbuf  = capacity of the flight, req and spare arrays
+//
+// Objects are copied into the buffer of their destination and sent in one
+// non-blocking message when the buffer is full, when it is older than a
+// time budget, or when the process runs out of work. A buffer handed to
+// MPI_Isend() is only completed when a new buffer is needed, so sending
+// never waits for the receiver.
+typedef struct outbox
+{
+    int ndst, batch;
+    size_t size;
+    MPI_Datatype dt;
+    int tag;
+    MPI_Comm comm;
+    char **fill;
+    int *n;
+    double *since;
+    double oldest;
+    char **flight;
+    MPI_Request *req;
+    int nflight;
+    char **spare;
+    int nspare, maxbuf;
+    long pending;  // number of objects in the buffers, not sent yet
+    long messages; // number of messages sent
+    long objects;  // number of objects sent
+    long *sent;    // sent[d] is the number of objects sent to destination d
+} *outbox;
+
+// Creates the outgoing buffers of a process for the ranks of comm, sending
+// messages of at most batch>0 objects of the given size and datatype.
+outbox outbox_create(MPI_Comm comm, int batch, size_t size, MPI_Datatype dt, int tag);
+
+// Frees the buffers of outbox o. The objects not sent are lost and the
+// sends must have completed (see outbox_done()).
+void outbox_destroy(outbox o);
+
+// Sends the objects of the buffer of destination d, if any.
+void outbox_flush(outbox o, int d);
+
+// Sends the buffers whose first object was pushed before time t
+// (MPI_Wtime()), or all the non-empty buffers if t is +inf.
+void outbox_flush_before(outbox o, double t);
+
+// Returns true if all the sends have completed.
+bool outbox_done(outbox o);
+
+// Copies object obj into the buffer of destination d, sending the buffer
+// if it becomes full.
+static inline void outbox_push(outbox o, int d, const void *obj)
+{
+    if (o->n[d] == 0)
+    {
+        o->since[d] = MPI_Wtime();
+        if (o->since[d] < o->oldest)
+            o->oldest = o->since[d];
+    }
+    memcpy(o->fill[d] + o->n[d] * o->size, obj, o->size);
+    o->pending++;
+    if (++o->n[d] == o->batch)
+        outbox_flush(o, d);
+}
+
+#endif
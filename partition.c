@@ -0,0 +1,80 @@
+#include "partition.h"
+
+static const char *names[] = {"diag", "zobrist", "block", "abstract"};
+
+partition partition_create(partition_kind kind, int X, int Y, int size, int side)
+{
+    partition P;
+    P.kind = kind;
+    P.size = size;
+    P.X = X;
+    P.Y = Y;
+    P.dims[0] = P.dims[1] = 0;
+    P.tx = malloc(X * sizeof(unsigned));
+    P.ty = malloc(Y * sizeof(unsigned));
+
+    if (side < 1 || kind == PART_ZOBRIST)
+        side = 1;
+
+    if (kind == PART_BLOCK)
+    {
+        // A grid of dims[0] x dims[1] blocks, as square as possible
+        MPI_Dims_create(size, 2, P.dims);
+        for (int x = 0; x < X; x++)
+            P.tx[x] = (long)x * P.dims[0] / X;
+        for (int y = 0; y < Y; y++)
+            P.ty[y] = (long)y * P.dims[1] / Y * P.dims[0];
+    }
+    else
+    {
+        // Same keys for all the cells of a group, from the splitmix64 sequence
+        uint64_t s = 0x5EED;
+        unsigned key = 0;
+        for (int x = 0; x < X; x++)
+        {
+            if (x % side == 0)
+                key = mix64(s += 0x9E3779B97F4A7C15ULL) >> 32;
+            P.tx[x] = key;
+        }
+        for (int y = 0; y < Y; y++)
+        {
+            if (y % side == 0)
+                key = mix64(s += 0x9E3779B97F4A7C15ULL) >> 32;
+            P.ty[y] = key;
+        }
+    }
+    return P;
+}
+
+void partition_block(const partition *P, int rank, int *x0, int *y0, int *x1, int *y1)
+{
+    // Inverse of tx and ty: the first x such that x * dims[0] / X == bx is
+    // the ceiling of bx * X / dims[0]
+    long bx = rank % P->dims[0], by = rank / P->dims[0];
+    *x0 = (bx * P->X + P->dims[0] - 1) / P->dims[0];
+    *x1 = ((bx + 1) * P->X + P->dims[0] - 1) / P->dims[0];
+    *y0 = (by * P->Y + P->dims[1] - 1) / P->dims[1];
+    *y1 = ((by + 1) * P->Y + P->dims[1] - 1) / P->dims[1];
+}
+
+void partition_destroy(partition P)
+{
+    free(P.tx);
+    free(P.ty);
+}
+
+bool partition_parse(const char *name, partition_kind *kind)
+{
+    for (int k = 0; k < sizeof(names) / sizeof(*names); k++)
+        if (strcmp(name, names[k]) == 0)
+        {
+            *kind = k;
+            return true;
+        }
+    return false;
+}
+
+const char *partition_name(partition_kind kind)
+{
+    return names[kind];
+}
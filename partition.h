@@ -0,0 +1,70 @@
+#ifndef PARTITION_H
+#define PARTITION_H
+
+#include "tools.h"
+
+// Work distribution functions of the MPI engine: which process owns (opens,
+// expands and closes) the node of each cell.
+typedef enum
+{
+    PART_DIAGONAL, // (x + y) % P: neighbors are almost always on another process
+    PART_ZOBRIST,  // Zobrist hashing of the cells: balanced, no locality
+    PART_BLOCK,    // one rectangular block of cells per process: local, unbalanced
+    PART_ABSTRACT, // Zobrist hashing of square groups of cells (AHDA*)
+} partition_kind;
+
+// A partition of the cells of a grid among size processes.
+//
+//  kind = distribution function
+//  size = number of processes
+//  X, Y = dimensions of the grid
+//  dims = number of columns and rows of blocks (PART_BLOCK only)
+//  tx   = value of each column, tx[x] for 0<=x<X
+//  ty   = value of each row, ty[y] for 0<=y<Y
+//
+// The owner of a cell is computed from tx[x] and ty[y] only, so that it
+// costs two lookups in small tables.
+typedef struct
+{
+    partition_kind kind;
+    int size;
+    int X, Y;
+    int dims[2];
+    unsigned *tx;
+    unsigned *ty;
+} partition;
+
+// Creates the partition of the cells of a grid of dimensions X,Y among size
+// processes. Groups of PART_ABSTRACT are squares of side cells. The partition
+// is deterministic: every process builds the same one, before the grid.
+partition partition_create(partition_kind kind, int X, int Y, int size, int side);
+
+// Stores in [x0,x1[ x [y0,y1[ the block of cells owned by process rank.
+// P must be of kind PART_BLOCK.
+void partition_block(const partition *P, int rank, int *x0, int *y0, int *x1, int *y1);
+
+// Frees the tables of partition P.
+void partition_destroy(partition P);
+
+// Parses the name of a distribution function, returns false if unknown.
+bool partition_parse(const char *name, partition_kind *kind);
+
+// Returns the name of a distribution function.
+const char *partition_name(partition_kind kind);
+
+// Returns the rank of the process owning cell p.
+static inline int partition_owner(const partition *P, position p)
+{
+    switch (P->kind)
+    {
+    case PART_ZOBRIST:
+    case PART_ABSTRACT:
+        return (P->tx[p.x] ^ P->ty[p.y]) % P->size;
+    case PART_BLOCK:
+        return P->tx[p.x] + P->ty[p.y];
+    default:
+        return (p.x + p.y) % P->size;
+    }
+}
+
+#endif
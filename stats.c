@@ -0,0 +1,83 @@
+#include "stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void stats_start(search_stats *s, int peers, bool timed)
+{
+    long *peer_sent = s->peers == peers ? s->peer_sent : NULL;
+    if (peer_sent == NULL)
+    {
+        stats_free(s);
+        peer_sent = malloc(peers * sizeof(long));
+    }
+    memset(s, 0, sizeof(search_stats));
+    s->peers = peers;
+    s->peer_sent = peer_sent;
+    memset(s->peer_sent, 0, peers * sizeof(long));
+    s->timed = timed;
+    s->phase = STATS_EXPAND;
+    s->clock = timed ? MPI_Wtime() : 0;
+}
+
+void stats_stop(search_stats *s)
+{
+    if (s->timed)
+        stats_switch(s, s->phase, MPI_Wtime());
+}
+
+void stats_free(search_stats *s)
+{
+    if (s->peers > 0)
+        free(s->peer_sent);
+    s->peers = 0;
+}
+
+// Rows of the table printed by stats_print()
+#define STATS_ROWS (8 + STATS_PHASES)
+
+void stats_print(search_stats *s, MPI_Comm comm, int root, bool peers)
+{
+    static const char *names[STATS_ROWS] = {"Expanded",     "Reopened",  "Duplicates", "Open peak",
+                                            "Nodes sent",   "Messages",  "Bytes sent", "Nodes received",
+                                            "Receive (s)",  "Expand (s)", "Idle (s)",  "Path (s)"};
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    double v[STATS_ROWS] = {s->expanded, s->reopened, s->duplicates, s->open_peak,
+                            s->sent,     s->messages, s->bytes,      s->received};
+    for (int p = 0; p < STATS_PHASES; p++)
+        v[8 + p] = s->time[p];
+    double min[STATS_ROWS], max[STATS_ROWS], sum[STATS_ROWS];
+    MPI_Reduce(v, min, STATS_ROWS, MPI_DOUBLE, MPI_MIN, root, comm);
+    MPI_Reduce(v, max, STATS_ROWS, MPI_DOUBLE, MPI_MAX, root, comm);
+    MPI_Reduce(v, sum, STATS_ROWS, MPI_DOUBLE, MPI_SUM, root, comm);
+    if (rank == root)
+    {
+        printf("%-16s%14s%14s%14s\n", "Stats", "min", "avg", "max");
+        for (int i = 0; i < STATS_ROWS; i++)
+            printf("%-16s%14.6g%14.6g%14.6g\n", names[i], min[i], sum[i] / size, max[i]);
+    }
+    if (!peers)
+        return;
+
+    // Row r holds the nodes sent by process r to every process
+    long *sent = rank == root ? malloc((size_t)size * size * sizeof(long)) : NULL;
+    MPI_Gather(s->peer_sent, size, MPI_LONG, sent, size, MPI_LONG, root, comm);
+    if (rank == root)
+    {
+        printf("%-16s", "Sent from\\to");
+        for (int r = 0; r < size; r++)
+            printf("%10d", r);
+        printf("\n");
+        for (int r = 0; r < size; r++)
+        {
+            printf("%-16d", r);
+            for (int d = 0; d < size; d++)
+                printf("%10ld", sent[(size_t)r * size + d]);
+            printf("\n");
+        }
+        free(sent);
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+#include <mpi.h>
+
+// Phases of a search whose time is measured.
+typedef enum
+{
+    STATS_RECEIVE, // receiving the nodes of the other processes, empty polls
+                   // belong to the phase they interrupt
+    STATS_EXPAND,  // expanding nodes, a single process search is all expansion
+    STATS_IDLE,    // nothing to expand, waiting for nodes or for the end
+    STATS_PATH,    // after the end of the search, rebuilding the path
+    STATS_PHASES
+} stats_phase;
+
+// Counters of the last search of a process.
+//
+//  expanded   = nodes expanded
+//  reopened   = closed nodes opened again by a cheaper path, expanded twice
+//  duplicates = nodes dropped because their cell had a path as cheap
+//  open_peak  = largest number of nodes in the open list
+//  sent       = nodes sent to the other processes, in messages messages of
+//               bytes bytes in all
+//  received   = nodes received from the other processes
+//  peers      = number of processes
+//  peer_sent  = peer_sent[r] is the number of nodes sent to process r, the
+//               nodes received from r are the ones r sent to this process
+//  time       = time[p] is the time spent in phase p, in seconds, only the
+//               MPI engine switches phases
+//  timed      = whether the phases are timed, else time stays at 0
+//  phase      = current phase, since clock (MPI_Wtime())
+//
+// The engines that the counters do not apply to leave them at 0.
+typedef struct
+{
+    long expanded, reopened, duplicates, open_peak;
+    long sent, messages, bytes, received;
+    int peers;
+    long *peer_sent;
+    double time[STATS_PHASES];
+    bool timed;
+    stats_phase phase;
+    double clock;
+} search_stats;
+
+// Resets the counters of s for a search among peers processes, and if timed
+// starts the clock in phase STATS_EXPAND.
+void stats_start(search_stats *s, int peers, bool timed);
+
+// Stops the clock of s.
+void stats_stop(search_stats *s);
+
+// Frees the arrays of s.
+void stats_free(search_stats *s);
+
+// Reduces the counters of the processes of comm and prints, on process
+// root, their minimum, average and maximum, and for peers the number of
+// nodes sent by every process to every other one. Collective.
+void stats_print(search_stats *s, MPI_Comm comm, int root, bool peers);
+
+// Ends the current phase of s and starts phase p at time now (MPI_Wtime()).
+// Callers skip it if s is not timed, so that untimed searches never read
+// the clock.
+static inline void stats_switch(search_stats *s, stats_phase p, double now)
+{
+    s->time[s->phase] += now - s->clock;
+    s->clock = now;
+    s->phase = p;
+}
+
+// Records an open list of n nodes.
+static inline void stats_open(search_stats *s, long n)
+{
+    if (n > s->open_peak)
+        s->open_peak = n;
+}
+
+#endif
@@ -1,4 +1,9 @@
+#define _DEFAULT_SOURCE // mmap(), getline() and random() under -std=c11
 #include "tools.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 // Returns true if (i,j) is on the border of grid G.
 static inline int onBorder(grid *G, int i, int j)
@@ -6,33 +11,60 @@ static inline int onBorder(grid *G, int i, int j)
     return (i == 0) || (j == 0) || (i == G->X - 1) || (j == G->Y - 1);
 }
 
-// Allocates a grid with dimensions x,y as well as its image.
-// We force x,y>=3 to have at least one point that is not on the border.
-static grid allocGrid(int x, int y)
+// Allocates the block [x0,x0+lx[ x [y0,y0+ly[ of a grid with dimensions x,y
+// as well as its image. The caller checks that the block is inside the grid.
+static grid allocBlock(int x, int y, int x0, int y0, int lx, int ly)
 {
     grid G;
     position p = {-1, -1};
     G.start = G.end = p;
-    if (x < 3)
-        x = 3;
-    if (y < 3)
-        y = 3;
     G.X = x;
     G.Y = y;
-    G.value = malloc(x * sizeof(*(G.value)));
-    G.mark = malloc(x * sizeof(*(G.mark)));
+    G.x0 = x0;
+    G.y0 = y0;
+    G.LX = lx;
+    G.LY = ly;
+    G.stride = (lx + GRID_ALIGN - 1) / GRID_ALIGN * GRID_ALIGN;
+    G.win = MPI_WIN_NULL;
+    G.mapped = 0;
+    G.epoch = MARK_FIRST_EPOCH;
 
-    for (int i = 0; i < x; i++)
+    // One contiguous block per array, the size is a multiple of GRID_ALIGN as
+    // required by aligned_alloc()
+    size_t size = gridSize(&G);
+    G.value = aligned_alloc(GRID_ALIGN, size);
+    G.mark = aligned_alloc(GRID_ALIGN, size);
+    if (G.value == NULL || G.mark == NULL)
     {
-        G.value[i] = malloc(y * sizeof(*(G.value[i])));
-        G.mark[i] = malloc(y * sizeof(*(G.mark[i])));
-        for (int j = 0; j < y; j++)
-            G.mark[i][j] = M_NULL; // initialise
+        fprintf(stderr, "Cannot allocate a %dx%d grid\n", lx, ly);
+        exit(EXIT_FAILURE);
     }
 
+    memset(G.value, V_WALL, size); // padding is never visited
+    memset(G.mark, M_NULL, size);  // initialise
+
     return G;
 }
 
+// Allocates a grid with dimensions x,y as well as its image.
+// We force x,y>=3 to have at least one point that is not on the border.
+static grid allocGrid(int x, int y)
+{
+    if (x < 3)
+        x = 3;
+    if (y < 3)
+        y = 3;
+    return allocBlock(x, y, 0, 0, x, y);
+}
+
+// Returns a random number in [0,1[ that only depends on seed and (x,y), so
+// that any process can draw the value of any cell without drawing the others
+// (mix64() of the cell counter).
+static double cellRandom(unsigned seed, int x, int y)
+{
+    return (mix64(((uint64_t)seed << 32 | (uint32_t)y) * 0x9E3779B97F4A7C15ULL + (uint32_t)x) >> 11) * 0x1.0p-53;
+}
+
 // Returns a random position on the grid that is uniform among all values of the grid of type t (excluding the borders of the grid).
 // If no type t cases are found, the position {-1,-1} is returned.
 position randomPosition(grid G, int t)
@@ -57,7 +89,7 @@ position randomPosition(grid G, int t)
         n = 0;
         for (i = 1; i < x1; i++)
             for (j = 1; j < y1; j++)
-                if (G.value[i][j] == t)
+                if (gridValue(&G, i, j) == t)
                 {
                     if (n == r)
                     {
@@ -74,36 +106,227 @@ position randomPosition(grid G, int t)
     return p;
 }
 
-// Frees the pointers allocated by allocGrid().
+// Header of a grid file, written by saveGridFile(). The cells follow at
+// offset GRID_FILE_DATA, a multiple of the page size: the rows of a file
+// without tiles are stored with their padding, as in memory, so that
+// initGridFile() maps them as they are. A file with tiles stores, for the
+// tiles of tile x tile cells in row-major order, the offsets of their data
+// from GRID_FILE_DATA (one more for the end), then the data of every tile:
+// the runs of its cells, row by row, as pairs of bytes (length - 1, value).
+typedef struct
+{
+    char magic[8];
+    int32_t X, Y;
+    position start, end;
+    int32_t stride; // bytes of a row, padding included
+    int32_t tile;   // side of the tiles, 0 if the rows are stored as they are
+} grid_file_header;
+
+#define GRID_FILE_DATA 4096
+
+static const char grid_magic[8] = "GRID v1";
+
+// Frees the values of a grid, allocated or mapped from a file if mapped > 0.
+static void freeValues(uint8_t *value, size_t mapped)
+{
+    if (mapped > 0)
+        munmap(value - GRID_FILE_DATA, mapped);
+    else
+        free(value);
+}
+
+// Frees the pointers allocated by allocGrid(), the mapping of a grid file,
+// or the window of a shared grid (collective over the processes sharing it).
 void freeGrid(grid G)
 {
-    for (int i = 0; i < G.X; i++)
+    if (G.win != MPI_WIN_NULL)
+        MPI_Win_free(&G.win);
+    else
+        freeValues(G.value, G.mapped);
+    free(G.mark);
+}
+
+// Starts a new epoch of the marks of G, which makes all of them M_NULL. When
+// the epochs wrap around, every 62 calls, the marks are reset for real.
+void clearGridMarks(grid *G)
+{
+    if (G->epoch > UINT8_MAX + 1 - 2 * MARK_KINDS)
     {
-        free(G.value[i]);
-        free(G.mark[i]);
+        memset(G->mark, 0, gridSize(G));
+        G->epoch = MARK_FIRST_EPOCH;
     }
-    free(G.value);
-    free(G.mark);
+    else
+        G->epoch += MARK_KINDS;
 }
 
-// Returns a grid of dimensions x,y initialized with random values.
-grid initGridPoints(int x, int y, int type, double density)
+// FNV-1a hash of the values of G, row by row. G must store the whole grid.
+uint64_t gridHash(const grid *G)
 {
-    grid G = allocGrid(x, y); // Allocates the grid and its image
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (int y = 0; y < G->Y; y++)
+        for (int x = 0; x < G->X; x++)
+            h = (h ^ gridValue(G, x, y)) * 0x100000001b3ULL;
+    return h;
+}
+
+// Returns a copy of grid G whose values are stored once in a window shared by
+// the processes of comm, which must all run on the same node. Only the process
+// of rank 0 of comm provides G, the others pass any grid with G.value == NULL
+// and get its dimensions and positions. The marks stay private.
+grid shareGrid(grid G, MPI_Comm comm)
+{
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    uint8_t *value = G.value;
+    MPI_Bcast(&G, sizeof(grid), MPI_BYTE, 0, comm);
 
+    // Only the window of rank 0 has memory, the others point to it
+    size_t size = gridSize(&G);
+    MPI_Aint wsize;
+    int disp_unit;
+    MPI_Win_allocate_shared(rank == 0 ? size : 0, 1, MPI_INFO_NULL, comm, &G.value, &G.win);
+    MPI_Win_shared_query(G.win, 0, &wsize, &disp_unit, &G.value);
+
+    if (rank == 0)
+    {
+        memcpy(G.value, value, size);
+        freeValues(value, G.mapped);
+    }
+    else
+    {
+        G.mark = aligned_alloc(GRID_ALIGN, size);
+        if (G.mark == NULL)
+        {
+            fprintf(stderr, "Cannot allocate a %dx%d grid\n", G.LX, G.LY);
+            exit(EXIT_FAILURE);
+        }
+        memset(G.mark, M_NULL, size);
+    }
+
+    // The values are read-only from now on
+    G.mapped = 0;
+    MPI_Win_fence(0, G.win);
+    return G;
+}
+
+// Runs run() on the n jobs of size bytes at jobs, the first one on the
+// calling thread and each other one on its own thread, or on the calling
+// thread if no thread is left.
+static void runJobs(void *(*run)(void *), void *jobs, size_t size, int n)
+{
+    pthread_t *thread = malloc(n * sizeof(pthread_t));
+    bool *started = calloc(n, sizeof(bool));
+    for (int t = 1; t < n; t++)
+        started[t] = pthread_create(&thread[t], NULL, run, (char *)jobs + t * size) == 0;
+    run(jobs);
+    for (int t = 1; t < n; t++)
+    {
+        if (started[t])
+            pthread_join(thread[t], NULL);
+        else
+            run((char *)jobs + t * size);
+    }
+    free(thread);
+    free(started);
+}
+
+// Sends to all the processes of comm the rows first[r] <= y < first[r + 1]
+// of the whole grid G that process r filled.
+static void gatherRows(grid *G, const int *first, MPI_Comm comm)
+{
+    int size;
+    MPI_Comm_size(comm, &size);
+    if (size == 1)
+        return;
+
+    int *count = malloc(size * sizeof(int));
+    for (int r = 0; r < size; r++)
+        count[r] = first[r + 1] - first[r];
+    MPI_Datatype row;
+    MPI_Type_contiguous(G->stride, MPI_UINT8_T, &row);
+    MPI_Type_commit(&row);
+    MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, G->value, count, first, row, comm);
+    MPI_Type_free(&row);
+    free(count);
+}
+
+// Rows [y0,y1[ of a grid of random points filled by a thread
+typedef struct
+{
+    grid *G;
+    int type;
+    double density;
+    unsigned seed;
+    int y0, y1;
+} points_job;
+
+static void *fillPoints(void *arg)
+{
+    points_job *j = arg;
+    grid *G = j->G;
+    for (int y = j->y0; y < j->y1; y++)
+        for (int x = G->x0; x < G->x0 + G->LX; x++)
+            setGridValue(G, x, y,
+                         onBorder(G, x, y) ? V_WALL : ((cellRandom(j->seed, x, y) <= j->density) ? j->type : V_FREE));
+    return NULL;
+}
+
+// Fills the cells of G on the rows [y0,y1[ with random values, on threads
+// threads.
+static void fillPointRows(grid *G, int type, double density, unsigned seed, int y0, int y1, int threads)
+{
     // Verify correct type, default: M_NULL
     if ((type < 0))
         type = M_NULL;
 
-    // Put the borders and fills the inside
-    for (int i = 0; i < x; i++)
-        for (int j = 0; j < y; j++)
-            G.value[i][j] =
-                onBorder(&G, i, j) ? V_WALL : ((RAND01 <= density) ? type : V_FREE);
+    points_job *J = malloc(threads * sizeof(points_job));
+    for (int t = 0; t < threads; t++)
+        J[t] = (points_job){G, type, density, seed, y0 + (long)(y1 - y0) * t / threads,
+                            y0 + (long)(y1 - y0) * (t + 1) / threads};
+    runJobs(fillPoints, J, sizeof(points_job), threads);
+    free(J);
+}
+
+// Returns a grid of dimensions x,y initialized with random values. The value
+// of a cell only depends on seed and its position: the processes of comm
+// fill a stripe of rows each, on threads threads, then exchange them, and
+// the grid is the same for any number of processes and threads.
+grid initGridPoints(int x, int y, int type, double density, unsigned seed, MPI_Comm comm, int threads)
+{
+    grid G = allocGrid(x, y); // Allocates the grid and its image
+
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    int *first = malloc((size + 1) * sizeof(int));
+    for (int r = 0; r <= size; r++)
+        first[r] = (long)G.Y * r / size;
+    fillPointRows(&G, type, density, seed, first[rank], first[rank + 1], threads);
+    gatherRows(&G, first, comm);
+    free(first);
+
+    // Default position
+    G.start = (position){.x = G.X - 2, .y = G.Y - 2};
+    G.end = (position){.x = 1, .y = 1};
+
+    return G;
+}
 
-    // Random position start/end
-    // G.start = randomPosition(G, V_FREE);
-    // G.end = randomPosition(G, V_FREE);
+// Returns the block [x0,x1[ x [y0,y1[, plus a border of one cell clipped to
+// the grid, of the grid of initGridPoints(), filled on threads threads.
+grid initGridPointsBlock(int x, int y, int type, double density, unsigned seed,
+                         int x0, int y0, int x1, int y1, int threads)
+{
+    if (x < 3)
+        x = 3;
+    if (y < 3)
+        y = 3;
+    x0 = x0 > 0 ? x0 - 1 : 0;
+    y0 = y0 > 0 ? y0 - 1 : 0;
+    x1 = x1 < x ? x1 + 1 : x;
+    y1 = y1 < y ? y1 + 1 : y;
+    grid G = allocBlock(x, y, x0, y0, x1 - x0, y1 - y0);
+    fillPointRows(&G, type, density, seed, y0, y1, threads);
 
     // Default position
     G.start = (position){.x = G.X - 2, .y = G.Y - 2};
@@ -112,12 +335,185 @@ grid initGridPoints(int x, int y, int type, double density)
     return G;
 }
 
-// Returns a random grid of dimensions x,y (at least 3) corresponding to a random uniform spanning tree.
-// We fix the start point = bottom right and end = top left. The width of the corridors is given by w>0.
-// This is the Wilson algorithm by "random walks with loop erasure" (see https://bl.ocks.org/mbostock/11357811).
-grid initGridLaby(int x, int y, int w)
+// Side of the tiles of the mazes, in cells of the maze
+#define LABY_TILE 64
+
+// Returns the next number of the random stream whose state is *state
+// (splitmix64).
+static uint64_t nextRandom(uint64_t *state)
+{
+    return mix64(*state += 0x9E3779B97F4A7C15ULL);
+}
+
+// Moves of the spanning trees: left, up, right, down
+static const int laby_dx[4] = {-1, 0, 1, 0}, laby_dy[4] = {0, -1, 0, 1};
+
+// Draws a uniform spanning tree of the w x h cells of a rectangle with the
+// random stream *state, by Wilson's algorithm: random walks from the cells
+// outside the tree until they reach it, whose loops are erased by keeping
+// the last move out of every cell. Stores in dir[y * w + x] the move from
+// (x,y) to its parent, -1 for the root.
+static void wilson(int w, int h, uint64_t *state, int8_t *dir)
+{
+    int n = w * h;
+    bool *in = calloc(n, sizeof(bool));
+    int root = nextRandom(state) % n;
+    in[root] = true;
+    dir[root] = -1;
+    for (int c0 = 0; c0 < n; c0++)
+    {
+        for (int c = c0; !in[c];)
+        {
+            int x = c % w, y = c / w, d;
+            do
+                d = nextRandom(state) & 3;
+            while (x + laby_dx[d] < 0 || x + laby_dx[d] >= w || y + laby_dy[d] < 0 || y + laby_dy[d] >= h);
+            dir[c] = d;
+            c += laby_dy[d] * w + laby_dx[d];
+        }
+        for (int c = c0; !in[c]; c += laby_dy[dir[c]] * w + laby_dx[dir[c]])
+            in[c] = true;
+    }
+    free(in);
+}
+
+// A maze of x,y cells, with corridors of width w, cut into tiles of
+// LABY_TILE x LABY_TILE cells. The cells of a tile form a spanning tree of
+// their own, drawn from the random stream of the tile, and the tiles a
+// spanning tree whose edges are doors between two tiles.
+//
+//  TX, TY    = number of tiles along x and y, tile t is the tile t % TX of
+//              the row of tiles t / TX
+//  door_left = the row, in the tile, of the door of tile t to the tile on its
+//              left, or -1
+//  door_up   = the column of the door of tile t to the tile above, or -1
+typedef struct
 {
+    int x, y, w;
+    unsigned seed;
+    int TX, TY;
+    int *door_left, *door_up;
+} laby;
 
+// Returns the maze of x,y cells of seed, with the doors between its tiles.
+static laby initLaby(int x, int y, int w, unsigned seed)
+{
+    laby L = {x, y, w, seed, (x + LABY_TILE - 1) / LABY_TILE, (y + LABY_TILE - 1) / LABY_TILE, NULL, NULL};
+    int n = L.TX * L.TY;
+    L.door_left = malloc(n * sizeof(int));
+    L.door_up = malloc(n * sizeof(int));
+    for (int t = 0; t < n; t++)
+        L.door_left[t] = L.door_up[t] = -1;
+
+    // The stream of the tree of the tiles is the one after the streams of the tiles
+    uint64_t state = mix64((uint64_t)seed << 32 | (uint32_t)n);
+    int8_t *dir = malloc(n);
+    wilson(L.TX, L.TY, &state, dir);
+    for (int t = 0; t < n; t++)
+    {
+        if (dir[t] < 0)
+            continue;
+        int tx = t % L.TX, ty = t / L.TX, p = t + laby_dy[dir[t]] * L.TX + laby_dx[dir[t]];
+        int cw = tx == L.TX - 1 ? x - tx * LABY_TILE : LABY_TILE, ch = ty == L.TY - 1 ? y - ty * LABY_TILE : LABY_TILE;
+        int d = nextRandom(&state) % (laby_dy[dir[t]] == 0 ? ch : cw);
+        if (dir[t] == 0 || dir[t] == 1)
+            (dir[t] == 0 ? L.door_left : L.door_up)[t] = d;
+        else
+            (dir[t] == 2 ? L.door_left : L.door_up)[p] = d;
+    }
+    free(dir);
+    return L;
+}
+
+// Opens the wall between the adjacent cells (ax,ay) and (bx,by) of a maze
+// whose corridors are s - 1 wide, on the cells G stores.
+static void openWall(grid *G, int s, int ax, int ay, int bx, int by)
+{
+    int wx = (ax > bx ? ax : bx) * s, wy = (ay > by ? ay : by) * s;
+    for (int i = 1; i < s; i++)
+    {
+        int x = ax == bx ? ax * s + i : wx, y = ay == by ? ay * s + i : wy;
+        if (gridHas(G, x, y))
+            setGridValue(G, x, y, V_FREE);
+    }
+}
+
+// Tiles t0, t0 + step, ... < t1 of a maze carved by a thread
+typedef struct
+{
+    const laby *L;
+    grid *G;
+    int t0, t1, step;
+} laby_job;
+
+// Carves the tiles of a job, on the cells G stores. The cells of a tile, the
+// walls above and on the left of them, and its doors to the tiles above and
+// on the left, belong to the tile only: the threads never write the same
+// cells.
+static void *carveTiles(void *arg)
+{
+    laby_job *j = arg;
+    const laby *L = j->L;
+    grid *G = j->G;
+    int s = L->w + 1;
+    int8_t *dir = malloc(LABY_TILE * LABY_TILE);
+    for (int t = j->t0; t < j->t1; t += j->step)
+    {
+        int tx = t % L->TX, ty = t / L->TX;
+        int cx0 = tx * LABY_TILE, cy0 = ty * LABY_TILE;
+        int cw = tx == L->TX - 1 ? L->x - cx0 : LABY_TILE, ch = ty == L->TY - 1 ? L->y - cy0 : LABY_TILE;
+
+        // Cells of G of the tile, the last tiles also have the border
+        int x0 = cx0 * s, y0 = cy0 * s;
+        int x1 = tx == L->TX - 1 ? G->X : (cx0 + cw) * s, y1 = ty == L->TY - 1 ? G->Y : (cy0 + ch) * s;
+        x0 = x0 > G->x0 ? x0 : G->x0;
+        y0 = y0 > G->y0 ? y0 : G->y0;
+        x1 = x1 < G->x0 + G->LX ? x1 : G->x0 + G->LX;
+        y1 = y1 < G->y0 + G->LY ? y1 : G->y0 + G->LY;
+        if (x0 >= x1 || y0 >= y1)
+            continue;
+
+        // Walls around every cell, then the moves of the trees open them
+        for (int y = y0; y < y1; y++)
+            for (int x = x0; x < x1; x++)
+                setGridValue(G, x, y, (x % s == 0 || y % s == 0) ? V_WALL : V_FREE);
+        uint64_t state = mix64((uint64_t)L->seed << 32 | (uint32_t)t);
+        wilson(cw, ch, &state, dir);
+        for (int c = 0; c < cw * ch; c++)
+            if (dir[c] >= 0)
+                openWall(G, s, cx0 + c % cw, cy0 + c / cw, cx0 + c % cw + laby_dx[dir[c]],
+                         cy0 + c / cw + laby_dy[dir[c]]);
+        if (L->door_left[t] >= 0)
+            openWall(G, s, cx0 - 1, cy0 + L->door_left[t], cx0, cy0 + L->door_left[t]);
+        if (L->door_up[t] >= 0)
+            openWall(G, s, cx0 + L->door_up[t], cy0 - 1, cx0 + L->door_up[t], cy0);
+    }
+    free(dir);
+    return NULL;
+}
+
+// Carves the tiles [t0,t1[ of the maze L in G on threads threads.
+static void carveLaby(const laby *L, grid *G, int t0, int t1, int threads)
+{
+    laby_job *J = malloc(threads * sizeof(laby_job));
+    for (int t = 0; t < threads; t++)
+        J[t] = (laby_job){L, G, t0 + t, t1, threads};
+    runJobs(carveTiles, J, sizeof(laby_job), threads);
+    free(J);
+    free(L->door_left);
+    free(L->door_up);
+}
+
+// Returns a random maze of x,y cells (at least 3), whose corridors are w > 0
+// cells wide, with the start point = bottom right and end = top left. Every
+// cell is reached by exactly one path: the tiles of the maze are spanning
+// trees drawn by the Wilson algorithm by "random walks with loop erasure"
+// (see https://bl.ocks.org/mbostock/11357811), linked by a spanning tree of
+// the tiles. A tile only depends on seed: the processes of comm carve a
+// stripe of rows of tiles each, on threads threads, then exchange them, and
+// the maze is the same for any number of processes and threads.
+grid initGridLaby(int x, int y, int w, unsigned seed, MPI_Comm comm, int threads)
+{
     // Verify parameters
     if (x < 3)
         x = 3;
@@ -125,232 +521,625 @@ grid initGridLaby(int x, int y, int w)
         y = 3;
     if (w <= 0)
         w = 1;
+    grid G = allocGrid(x * (w + 1) + 1, y * (w + 1) + 1);
+    laby L = initLaby(x, y, w, seed);
+
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    int *first = malloc((size + 1) * sizeof(int));
+    for (int r = 0; r <= size; r++)
+    {
+        int ty = (long)L.TY * r / size;
+        first[r] = ty == L.TY ? G.Y : ty * LABY_TILE * (w + 1);
+    }
+    carveLaby(&L, &G, (long)L.TY * rank / size * L.TX, (long)L.TY * (rank + 1) / size * L.TX, threads);
+    gatherRows(&G, first, comm);
+    free(first);
 
-    // Allocates the grid and its image
-    int *value = malloc(x * y * sizeof(*value));
+    // Default position
+    G.start = (position){.x = G.X - 2, .y = G.Y - 2};
+    G.end = (position){.x = 1, .y = 1};
 
-    // Allocates the grid and its image
-    grid Gw = allocGrid(x * (w + 1) + 1, y * (w + 1) + 1);
+    return G;
+}
+
+// Returns the block [x0,x1[ x [y0,y1[, plus a border of one cell clipped to
+// the grid, of the maze of initGridLaby(), whose dimensions are x * (w + 1)
+// + 1, y * (w + 1) + 1. Only the tiles of the block are carved, on threads
+// threads.
+grid initGridLabyBlock(int x, int y, int w, unsigned seed, int x0, int y0, int x1, int y1, int threads)
+{
+    if (x < 3)
+        x = 3;
+    if (y < 3)
+        y = 3;
+    if (w <= 0)
+        w = 1;
+    int X = x * (w + 1) + 1, Y = y * (w + 1) + 1;
+    x0 = x0 > 0 ? x0 - 1 : 0;
+    y0 = y0 > 0 ? y0 - 1 : 0;
+    x1 = x1 < X ? x1 + 1 : X;
+    y1 = y1 < Y ? y1 + 1 : Y;
+    grid G = allocBlock(X, Y, x0, y0, x1 - x0, y1 - y0);
+    laby L = initLaby(x, y, w, seed);
+    carveLaby(&L, &G, 0, L.TX * L.TY, threads);
 
     // Default position
-    Gw.start = (position){.x = Gw.X - 2, .y = Gw.Y - 2};
-    Gw.end = (position){.x = 1, .y = 1};
+    G.start = (position){.x = G.X - 2, .y = G.Y - 2};
+    G.end = (position){.x = 1, .y = 1};
+
+    return G;
+}
 
-    // Initially walls only on the borders
-    for (int i = 0; i < Gw.X; i++)
+// Characters of the cells in the layout of saveGridValueFile()
+static const char value_chars[] = " #;~,.+"; // V_FREE to V_TUNNEL
+
+// Returns the value of the character c of the layout of saveGridValueFile(),
+// or -1. The origin and the destination are free cells.
+static int valueOfChar(char c)
+{
+    if (c == 's' || c == 't')
+        return V_FREE;
+    const char *p = c != '\0' ? strchr(value_chars, c) : NULL;
+    return p == NULL ? -1 : p - value_chars;
+}
+
+// Returns false, after printing why, if the stored cells of G on the border
+// of the grid are not all walls, which every search assumes, or if the
+// origin or the destination of G are out of the grid.
+static bool checkGrid(const grid *G, const char *filename)
+{
+    if (G->start.x < 0 || G->start.x >= G->X || G->start.y < 0 || G->start.y >= G->Y || G->end.x < 0 ||
+        G->end.x >= G->X || G->end.y < 0 || G->end.y >= G->Y)
     {
-        for (int j = 0; j < Gw.Y; j++)
+        fprintf(stderr, "The origin or the destination of %s is out of the grid\n", filename);
+        return false;
+    }
+    for (int y = G->y0; y < G->y0 + G->LY; y++)
+    {
+        bool row = y == 0 || y == G->Y - 1;
+        for (int x = G->x0; x < G->x0 + G->LX; x++)
         {
-            Gw.value[i][j] =
-                ((i % (w + 1) == 0) || (j % (w + 1) == 0)) ? V_WALL : V_FREE;
+            if (!row && x > 0 && x < G->X - 1)
+                x = G->X - 1; // inside a row, only the last column is on the border
+            if (gridHas(G, x, y) && gridValue(G, x, y) != V_WALL)
+            {
+                fprintf(stderr, "The border of %s must be walls, (%d,%d) is not\n", filename, x, y);
+                return false;
+            }
         }
     }
+    return true;
+}
+
+// Returns the grid of the layout that saveGridValueFile() writes: the rows of
+// the characters of the cells after a "#GRID_VALUE" line, ended by an empty
+// line. The origin is the cell 's' and the destination the cell 't', or the
+// corners as in the generated grids.
+grid initGridText(char *filename)
+{
+    FILE *f = fopen(filename, "r");
+    if (f == NULL)
+    {
+        fprintf(stderr, "Cannot read the grid file %s\n", filename);
+        exit(EXIT_FAILURE);
+    }
 
-    for (int i = 0; i < x; i++)
-        for (int j = 0; j < y; j++)
-            value[i * y + j] = -1;
+    // The rows first, to know the dimensions
+    char **rows = NULL, *line = NULL;
+    size_t n = 0;
+    int X = 0, Y = 0;
+    ssize_t len;
+    while ((len = getline(&line, &n, f)) >= 0)
+    {
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+            line[--len] = '\0';
+        if (Y == 0 && (len == 0 || strncmp(line, "#GRID_VALUE", 11) == 0))
+            continue;
+        if (len == 0)
+            break;
+        rows = realloc(rows, (Y + 1) * sizeof(char *));
+        rows[Y++] = strdup(line);
+        X = len > X ? len : X;
+    }
+    free(line);
+    fclose(f);
 
-    int count = 1;
-    value[0] = 0;
-    while (count < x * y)
+    grid G = allocGrid(X, Y);
+    G.start = (position){.x = G.X - 2, .y = G.Y - 2};
+    G.end = (position){.x = 1, .y = 1};
+    for (int y = 0; y < G.Y; y++)
     {
-        int i0 = 0;
-        while (i0 < x * y && value[i0] != -1)
-            i0++;
-        value[i0] = i0 + 1;
-        while (i0 < x * y)
+        int l = y < Y ? strlen(rows[y]) : 0;
+        for (int x = 0; x < G.X; x++)
         {
-            int x0 = i0 / y;
-            int y0 = i0 % y;
-            while (true)
+            char c = x < l ? rows[y][x] : '#'; // short rows end with walls
+            int v = valueOfChar(c);
+            if (v < 0)
             {
-                int dir = random() & 3; // same as random()%4
-                switch (dir)
-                {
-                case 0:
-                    if (x0 <= 0)
-                        continue;
-                    x0--;
-                    break;
-                case 1:
-                    if (y0 <= 0)
-                        continue;
-                    y0--;
-                    break;
-                case 2:
-                    if (x0 >= x - 1)
-                        continue;
-                    x0++;
-                    break;
-                case 3:
-                    if (y0 >= y - 1)
-                        continue;
-                    y0++;
-                    break;
-                }
-                break;
-            }
-            if (value[x0 * y + y0] == -1)
-            {
-                value[x0 * y + y0] = i0 + 1;
-                i0 = x0 * y + y0;
-            }
-            else
-            {
-                if (value[x0 * y + y0] > 0)
-                {
-                    while (i0 != x0 * y + y0 && i0 > 0)
-                    {
-                        int i1 = value[i0] - 1;
-                        value[i0] = -1;
-                        i0 = i1;
-                    }
-                }
-                else
-                {
-                    int i1 = i0;
-                    i0 = x0 * y + y0;
-                    do
-                    {
-                        int x0 = i0 / y;
-                        int y0 = i0 % y;
-                        int x1 = i1 / y;
-                        int y1 = i1 % y;
-                        if (x0 < x1)
-                            for (int i = 0; i < w; ++i)
-                                Gw.value[x1 * (w + 1)][y0 * (w + 1) + i + 1] = V_FREE;
-                        if (x0 > x1)
-                            for (int i = 0; i < w; ++i)
-                                Gw.value[x0 * (w + 1)][y0 * (w + 1) + i + 1] = V_FREE;
-                        if (y0 < y1)
-                            for (int i = 0; i < w; ++i)
-                                Gw.value[x1 * (w + 1) + i + 1][y1 * (w + 1)] = V_FREE;
-                        if (y0 > y1)
-                            for (int i = 0; i < w; ++i)
-                                Gw.value[x1 * (w + 1) + i + 1][y0 * (w + 1)] = V_FREE;
-                        i0 = i1;
-                        i1 = value[i0] - 1;
-                        value[i0] = 0;
-                        count++;
-                    } while (value[i1] != 0);
-                    break;
-                }
+                fprintf(stderr, "Invalid cell '%c' at (%d,%d) of %s\n", c, x, y, filename);
+                exit(EXIT_FAILURE);
             }
+            setGridValue(&G, x, y, v);
+            if (c == 's')
+                G.start = (position){x, y};
+            else if (c == 't')
+                G.end = (position){x, y};
         }
     }
+    for (int y = 0; y < Y; y++)
+        free(rows[y]);
+    free(rows);
+    if (!checkGrid(&G, filename))
+        exit(EXIT_FAILURE);
+    return G;
+}
 
-    free(value);
+// Reads the header of the grid file filename into h, returns false if it is
+// not a grid file.
+static bool readGridHeader(const char *filename, grid_file_header *h)
+{
+    FILE *f = fopen(filename, "rb");
+    if (f == NULL)
+        return false;
+    bool ok = fread(h, sizeof(*h), 1, f) == 1 && memcmp(h->magic, grid_magic, sizeof(grid_magic)) == 0;
+    fclose(f);
+    return ok;
+}
 
-    return Gw;
+bool isGridFile(char *filename)
+{
+    grid_file_header h;
+    return readGridHeader(filename, &h);
 }
 
-void saveGridValueFile(grid G, char *filename)
+bool gridFileSize(char *filename, int *X, int *Y)
 {
-    // MPI_File f;
-    // if (MPI_File_open(MPI_COMM_SELF, "test-val.txt", MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &f) != MPI_SUCCESS)
-    // {
-    //     printf("Failure in opening the file.\n");
-    //     MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
-    // };
-    char c;
-    char new_line = '\n';
-    fprintf(stderr, "#GRID_VALUE\n\n");
-    for (int y = 0; y < G.Y; y++)
+    grid_file_header h;
+    if (!readGridHeader(filename, &h))
+        return false;
+    *X = h.X;
+    *Y = h.Y;
+    return true;
+}
+
+// Returns the grid of a file written by saveGridFile(). The values of a file
+// without tiles are mapped in memory, privately: only the border is read, to
+// check it, before the search touches the cells, and the processes of a node
+// reading the same file share the pages of the file cache. The values of a
+// file with tiles are decoded in memory, once their offsets and runs are
+// checked against the size of the file and of the tiles.
+grid initGridFile(char *filename)
+{
+    grid_file_header h;
+    int fd = open(filename, O_RDONLY);
+    struct stat st;
+    bool ok = fd >= 0 && fstat(fd, &st) == 0 && readGridHeader(filename, &h) && h.X >= 3 && h.Y >= 3 &&
+              h.stride == (h.X + GRID_ALIGN - 1) / GRID_ALIGN * GRID_ALIGN && h.tile >= 0 &&
+              st.st_size >= GRID_FILE_DATA + (h.tile == 0 ? (off_t)h.stride * h.Y : 0);
+    uint8_t *map = ok ? mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    if (fd >= 0)
+        close(fd);
+    if (map == MAP_FAILED)
     {
-        for (int x = 0; x < G.X; x++)
+        fprintf(stderr, "Cannot read the grid file %s\n", filename);
+        exit(EXIT_FAILURE);
+    }
+
+    grid G;
+    if (h.tile == 0)
+    {
+        // The grid uses the mapping, only the marks are allocated
+        G = allocBlock(h.X, h.Y, 0, 0, h.X, h.Y);
+        free(G.value);
+        G.value = map + GRID_FILE_DATA;
+        G.mapped = st.st_size;
+    }
+    else
+    {
+        G = allocGrid(h.X, h.Y);
+        long TX = (h.X + (long)h.tile - 1) / h.tile, TY = (h.Y + (long)h.tile - 1) / h.tile;
+        const uint64_t *offset = (const uint64_t *)(map + GRID_FILE_DATA);
+        uint64_t data = st.st_size - GRID_FILE_DATA; // bytes after the header
+        ok = (uint64_t)(TX * TY + 1) * sizeof(uint64_t) <= data;
+        for (long t = 0; t < TX * TY && ok; t++)
         {
-            int v = G.value[x][y];
-            switch (v)
-            {
-            case V_FREE:
-                c = ' ';
+            // Cells of the tile, row by row, from its runs, within the file
+            int x0 = t % TX * h.tile, y0 = t / TX * h.tile;
+            int w = x0 + h.tile < h.X ? h.tile : h.X - x0, l = y0 + h.tile < h.Y ? h.tile : h.Y - y0;
+            ok = offset[t] <= offset[t + 1] && offset[t + 1] <= data;
+            if (!ok)
                 break;
-            case V_WALL:
-                c = '#';
-                break;
-            case V_SAND:
-                c = ';';
-                break;
-            case V_WATER:
-                c = '~';
-                break;
-            case V_MUD:
-                c = ',';
-                break;
-            case V_GRASS:
-                c = '.';
-                break;
-            case V_TUNNEL:
-                c = '+';
-                break;
-            default:
-                c = ' ';
+            const uint8_t *run = map + GRID_FILE_DATA + offset[t], *end = map + GRID_FILE_DATA + offset[t + 1];
+            long c = 0, cells = (long)w * l;
+            for (; run + 1 < end && c < cells && ok; run += 2)
+            {
+                ok = run[1] <= V_TUNNEL && c + run[0] < cells;
+                for (int k = 0; k <= run[0] && ok; k++, c++)
+                    setGridValue(&G, x0 + c % w, y0 + c / w, run[1]);
             }
-            if (x == G.start.x && y == G.start.y)
-                c = 's';
-            else if (x == G.end.x && y == G.end.y)
-                c = 't';
-            fprintf(stderr, "%c", c);
-            // MPI_File_write(f, &c, 1, MPI_CHAR, MPI_STATUS_IGNORE);
+            ok = ok && c == cells;
         }
-        fprintf(stderr, "%c", new_line);
-        // MPI_File_write(f, &new_line, 1, MPI_CHAR, MPI_STATUS_IGNORE);
-    }
-    fprintf(stderr, "\n\n");
-    // if (MPI_File_close(&f) != MPI_SUCCESS)
-    // {
-    //     printf("Failure in closing the file.\n");
-    //     MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
-    // }
-    // debug(0, "I am here 3-1\n");
-}
-
-void saveGridMarkFile(grid G, char *filename)
-{
-    // MPI_File f;
-    // if (MPI_File_open(MPI_COMM_SELF, "test_mark.txt", MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &f) != MPI_SUCCESS)
-    // {
-    //     printf("Failure in opening the file.\n");
-    //     MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
-    // };
-    char c;
-    char new_line = '\n';
-    fprintf(stderr, "#GRID_MARK\n\n");
-    for (int y = 0; y < G.Y; y++)
+        munmap(map, st.st_size);
+        if (!ok)
+        {
+            fprintf(stderr, "Corrupted grid file %s\n", filename);
+            exit(EXIT_FAILURE);
+        }
+    }
+    G.start = h.start;
+    G.end = h.end;
+    if (!checkGrid(&G, filename))
+        exit(EXIT_FAILURE);
+    return G;
+}
+
+// Returns the block [x0,x1[ x [y0,y1[, plus a border of one cell clipped to
+// the grid, of the grid file filename, which must store its rows as they are.
+// The processes of comm read their blocks at once, collectively, each one
+// only the bytes of its block.
+grid initGridFileBlock(char *filename, int x0, int y0, int x1, int y1, MPI_Comm comm)
+{
+    grid_file_header h;
+    MPI_File f;
+    MPI_Offset bytes = 0;
+    bool ok = readGridHeader(filename, &h) && h.X >= 3 && h.Y >= 3 && h.tile == 0 &&
+              h.stride == (h.X + GRID_ALIGN - 1) / GRID_ALIGN * GRID_ALIGN &&
+              MPI_File_open(comm, filename, MPI_MODE_RDONLY, MPI_INFO_NULL, &f) == MPI_SUCCESS;
+    if (ok && (MPI_File_get_size(f, &bytes) != MPI_SUCCESS || bytes < GRID_FILE_DATA + (MPI_Offset)h.stride * h.Y))
     {
-        for (int x = 0; x < G.X; x++)
+        MPI_File_close(&f);
+        ok = false;
+    }
+    if (!ok)
+    {
+        fprintf(stderr, "Cannot read the blocks of the grid file %s, which needs rows without tiles\n", filename);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+
+    x0 = x0 > 0 ? x0 - 1 : 0;
+    y0 = y0 > 0 ? y0 - 1 : 0;
+    x1 = x1 < h.X ? x1 + 1 : h.X;
+    y1 = y1 < h.Y ? y1 + 1 : h.Y;
+    grid G = allocBlock(h.X, h.Y, x0, y0, x1 - x0, y1 - y0);
+
+    // The block is a subarray of the rows of the file, and of the rows of G
+    // without their padding
+    MPI_Datatype in_file, in_grid;
+    int sizes[2] = {h.Y, h.stride}, subsizes[2] = {G.LY, G.LX}, starts[2] = {y0, x0};
+    MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_UINT8_T, &in_file);
+    int grid_sizes[2] = {G.LY, G.stride}, grid_starts[2] = {0, 0};
+    MPI_Type_create_subarray(2, grid_sizes, subsizes, grid_starts, MPI_ORDER_C, MPI_UINT8_T, &in_grid);
+    MPI_Type_commit(&in_file);
+    MPI_Type_commit(&in_grid);
+    MPI_File_set_view(f, GRID_FILE_DATA, MPI_UINT8_T, in_file, "native", MPI_INFO_NULL);
+    ok = MPI_File_read_all(f, G.value, 1, in_grid, MPI_STATUS_IGNORE) == MPI_SUCCESS;
+    MPI_Type_free(&in_file);
+    MPI_Type_free(&in_grid);
+    MPI_File_close(&f);
+    if (!ok)
+    {
+        fprintf(stderr, "Cannot read the grid file %s\n", filename);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+
+    G.start = h.start;
+    G.end = h.end;
+    if (!checkGrid(&G, filename))
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    return G;
+}
+
+// Appends the runs of the cells of the tile (x0,y0) of G to buffer b, of
+// size *n and capacity *nmax.
+static void appendRuns(grid *G, int x0, int y0, int tile, uint8_t **b, size_t *n, size_t *nmax)
+{
+    int w = x0 + tile < G->X ? tile : G->X - x0, l = y0 + tile < G->Y ? tile : G->Y - y0;
+    long cells = (long)w * l;
+    for (long c = 0; c < cells;)
+    {
+        int v = gridValue(G, x0 + c % w, y0 + c / w), k = 1;
+        while (k < 256 && c + k < cells && gridValue(G, x0 + (c + k) % w, y0 + (c + k) / w) == v)
+            k++;
+        if (*n + 2 > *nmax)
         {
-            int m = G.mark[x][y];
-            switch (m)
+            *nmax = *nmax ? 2 * *nmax : 4096;
+            *b = realloc(*b, *nmax);
+        }
+        (*b)[(*n)++] = k - 1;
+        (*b)[(*n)++] = v;
+        c += k;
+    }
+}
+
+// Writes the whole grid G to the grid file filename, with the rows as they
+// are if tile is 0, or compressed by tiles of tile x tile cells. Returns
+// false if it cannot.
+bool saveGridFile(grid G, char *filename, int tile)
+{
+    FILE *f = fopen(filename, "wb");
+    if (f == NULL)
+        return false;
+
+    grid_file_header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, grid_magic, sizeof(grid_magic));
+    h.X = G.X;
+    h.Y = G.Y;
+    h.start = G.start;
+    h.end = G.end;
+    h.stride = G.stride;
+    h.tile = tile;
+    static const uint8_t zeros[GRID_FILE_DATA];
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+              fwrite(zeros, 1, GRID_FILE_DATA - sizeof(h), f) == GRID_FILE_DATA - sizeof(h);
+
+    if (tile == 0)
+    {
+        ok = ok && fwrite(G.value, 1, gridSize(&G), f) == gridSize(&G);
+    }
+    else
+    {
+        int TX = (G.X + tile - 1) / tile, TY = (G.Y + tile - 1) / tile;
+        uint64_t *offset = malloc((TX * TY + 1) * sizeof(uint64_t));
+        uint8_t *runs = NULL;
+        size_t n = 0, nmax = 0;
+        for (int t = 0; t < TX * TY; t++)
+        {
+            offset[t] = (TX * TY + 1) * sizeof(uint64_t) + n;
+            appendRuns(&G, t % TX * tile, t / TX * tile, tile, &runs, &n, &nmax);
+        }
+        offset[TX * TY] = (TX * TY + 1) * sizeof(uint64_t) + n;
+        ok = ok && fwrite(offset, sizeof(uint64_t), TX * TY + 1, f) == (size_t)TX * TY + 1 &&
+             fwrite(runs, 1, n, f) == n;
+        free(offset);
+        free(runs);
+    }
+    return fclose(f) == 0 && ok;
+}
+
+// Opens the dump filename of a grid of dimensions X,Y for writing by the
+// processes of comm, and writes its header line head, followed by an empty
+// line, and the empty line after the rows. Returns the offset of the first
+// row in *rows.
+static MPI_File openDump(const char *filename, const char *head, int X, int Y, MPI_Comm comm, MPI_Offset *rows)
+{
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    MPI_File f;
+    if (MPI_File_open(comm, filename, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &f) != MPI_SUCCESS)
+    {
+        fprintf(stderr, "Cannot write the dump %s\n", filename);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+
+    *rows = strlen(head) + 2;
+    MPI_Offset end = *rows + (MPI_Offset)Y * (X + 1);
+    MPI_File_set_size(f, end + 2);
+    if (rank == 0)
+    {
+        MPI_File_write_at(f, 0, head, strlen(head), MPI_CHAR, MPI_STATUS_IGNORE);
+        MPI_File_write_at(f, strlen(head), "\n\n", 2, MPI_CHAR, MPI_STATUS_IGNORE);
+        MPI_File_write_at(f, end, "\n\n", 2, MPI_CHAR, MPI_STATUS_IGNORE);
+    }
+    return f;
+}
+
+// Writes the characters [x0,x0+w[ of the rows [y0,y0+l[ of the dump f of a
+// grid of dimensions X,Y, whose rows start at offset rows, from buf, l rows
+// of w characters. Collective over the processes of f, which may write
+// nothing (l = 0).
+static void writeDumpBlock(MPI_File f, MPI_Offset rows, int X, int Y, int x0, int y0, int w, int l, const char *buf)
+{
+    MPI_Datatype block, row;
+    if (w > 0 && l > 0)
+    {
+        // The file is a matrix of Y rows of X characters and a newline
+        int sizes[2] = {Y, X + 1}, subsizes[2] = {l, w}, starts[2] = {y0, x0};
+        MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_CHAR, &block);
+        MPI_Type_commit(&block);
+        MPI_File_set_view(f, rows, MPI_CHAR, block, "native", MPI_INFO_NULL);
+        MPI_Type_free(&block);
+    }
+    else
+    {
+        MPI_File_set_view(f, rows, MPI_CHAR, MPI_CHAR, "native", MPI_INFO_NULL);
+        w = 1;
+        l = 0;
+    }
+    MPI_Type_contiguous(w, MPI_CHAR, &row);
+    MPI_Type_commit(&row);
+    MPI_File_write_all(f, buf, l, row, MPI_STATUS_IGNORE);
+    MPI_Type_free(&row);
+}
+
+// Sets [x0,x1[ x [y0,y1[ to the cells of G that this process writes in a
+// dump: a stripe of rows if all the processes of comm store the whole grid,
+// or its block without the border copied from its neighbors. Returns true
+// for stripes. Collective.
+static bool dumpRegion(const grid *G, MPI_Comm comm, int *x0, int *y0, int *x1, int *y1)
+{
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    // A process with a bounding box as large as the grid may still be part of
+    // a distributed one: all of them must store the whole grid for stripes
+    int whole = G->LX == G->X && G->LY == G->Y;
+    MPI_Allreduce(MPI_IN_PLACE, &whole, 1, MPI_INT, MPI_LAND, comm);
+    if (whole)
+    {
+        *x0 = 0;
+        *x1 = G->X;
+        *y0 = (long)G->Y * rank / size;
+        *y1 = (long)G->Y * (rank + 1) / size;
+    }
+    else
+    {
+        // See initGridPointsBlock() for the border
+        *x0 = G->x0 + (G->x0 > 0);
+        *y0 = G->y0 + (G->y0 > 0);
+        *x1 = G->x0 + G->LX - (G->x0 + G->LX < G->X);
+        *y1 = G->y0 + G->LY - (G->y0 + G->LY < G->Y);
+    }
+    return whole;
+}
+
+// Writes the values of G to filename, with the layout that initGridText()
+// reads: a "#GRID_VALUE" line, then the rows of the characters of the cells,
+// 's' for the origin and 't' for the destination. The rows have a fixed
+// length, so the processes of comm write their cells at once, collectively:
+// a stripe of rows each if they store the whole grid, or their block without
+// the border copied from their neighbors.
+void saveGridValueFile(grid G, char *filename, MPI_Comm comm)
+{
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    MPI_Offset rows;
+    MPI_File f = openDump(filename, "#GRID_VALUE", G.X, G.Y, comm, &rows);
+    int x0, y0, x1, y1;
+    dumpRegion(&G, comm, &x0, &y0, &x1, &y1);
+
+    // The process of the last column writes the newlines
+    int w = x1 - x0 + (x1 == G.X), l = y1 - y0;
+    char *buf = malloc((size_t)w * l + 1);
+    for (int y = y0; y < y1; y++)
+    {
+        char *c = buf + (size_t)(y - y0) * w;
+        for (int x = x0; x < x1; x++)
+        {
+            int v = gridValue(&G, x, y);
+            c[x - x0] = v <= V_TUNNEL ? value_chars[v] : ' ';
+        }
+        if (x1 == G.X)
+            c[w - 1] = '\n';
+        if (y == G.end.y && G.end.x >= x0 && G.end.x < x1)
+            c[G.end.x - x0] = 't';
+        if (y == G.start.y && G.start.x >= x0 && G.start.x < x1)
+            c[G.start.x - x0] = 's';
+    }
+    writeDumpBlock(f, rows, G.X, G.Y, x0, y0, w, l, buf);
+    free(buf);
+    MPI_File_close(&f);
+}
+
+// Writes the marks of G to filename, with the layout of saveGridValueFile()
+// after a "#GRID_MARK" line: ' ' for M_NULL, 'u' for M_USED, 'f' for M_FRONT
+// and 'p' for M_PATH. A cell is marked by the process that owns it, or on
+// the path by the one that builds it, which may not be the process writing
+// it: every process sends the marked cells it stores out of its own region
+// to the processes writing them, which keep the highest mark of a cell. The
+// processes then write their region as for the values.
+void saveGridMarkFile(grid G, char *filename, MPI_Comm comm)
+{
+    static const char mark_chars[] = " ufp"; // M_NULL to M_PATH
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    MPI_Offset rows;
+    MPI_File f = openDump(filename, "#GRID_MARK", G.X, G.Y, comm, &rows);
+    int x0, y0, x1, y1;
+    bool whole = dumpRegion(&G, comm, &x0, &y0, &x1, &y1);
+
+    // Regions of all the processes, and the ones that may receive cells
+    // stored by this process: the stripes, or the blocks overlapping its own
+    int (*region)[4] = malloc(size * sizeof(*region)), *near = malloc(size * sizeof(int)), nnear = 0;
+    MPI_Allgather((int[4]){x0, y0, x1, y1}, 4, MPI_INT, region, 4, MPI_INT, comm);
+    for (int r = 0; r < size; r++)
+        if (r != rank && region[r][0] < G.x0 + G.LX && G.x0 < region[r][2] && region[r][1] < G.y0 + G.LY &&
+            G.y0 < region[r][3])
+            near[nnear++] = r;
+
+    // Process writing each row of the stripes
+    int *writer = NULL;
+    if (whole)
+    {
+        writer = malloc(G.Y * sizeof(int));
+        for (int r = 0; r < size; r++)
+            for (int y = region[r][1]; y < region[r][3]; y++)
+                writer[y] = r;
+    }
+
+    // The marked cells of the regions of the other processes, as (x, y, mark)
+    // sorted by destination: the first pass counts them, the second one fills
+    // the buffer. The regions of local grids may overlap, every process
+    // writing a cell receives it.
+    int *count = calloc(size, sizeof(int)), *displ = calloc(size, sizeof(int)), *fill = calloc(size, sizeof(int));
+    int *cells = NULL;
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (int y = G.y0; y < G.y0 + G.LY; y++)
+            for (int x = G.x0; x < G.x0 + G.LX; x++)
             {
-            case M_NULL:
-                c = ' ';
-                break;
-            case M_PATH:
-                c = 'p';
-                break;
-            case M_USED:
-                c = 'u';
-                break;
-            case M_FRONT:
-                c = 'f';
-                break;
-            default:
-                c = ' ';
+                int m = gridHas(&G, x, y) ? gridMark(&G, x, y) : M_NULL;
+                if (m == M_NULL)
+                    continue;
+                for (int i = 0; i < (whole ? 1 : nnear); i++)
+                {
+                    int r = whole ? writer[y] : near[i];
+                    if (r == rank || x < region[r][0] || x >= region[r][2] || y < region[r][1] || y >= region[r][3])
+                        continue;
+                    if (pass == 1)
+                    {
+                        int *c = cells + displ[r] + fill[r];
+                        c[0] = x;
+                        c[1] = y;
+                        c[2] = m;
+                    }
+                    (pass == 0 ? count : fill)[r] += 3;
+                }
             }
-            fprintf(stderr, "%c", c);
-            // MPI_File_write(f, &c, 1, MPI_CHAR, MPI_STATUS_IGNORE);
+        if (pass == 0)
+        {
+            for (int r = 1; r < size; r++)
+                displ[r] = displ[r - 1] + count[r - 1];
+            cells = malloc((displ[size - 1] + count[size - 1] + 1) * sizeof(int));
         }
-        fprintf(stderr, "%c", new_line);
-        // MPI_File_write(f, &new_line, 1, MPI_CHAR, MPI_STATUS_IGNORE);
-    }
-    fprintf(stderr, "\n\n");
-    // if (MPI_File_close(&f) != MPI_SUCCESS)
-    // {
-    //     printf("Failure in closing the file.\n");
-    //     MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
-    // }
-    // debug(0, "I am here 3-2\n");
+    }
+    int *rcount = malloc(size * sizeof(int)), *rdispl = calloc(size, sizeof(int));
+    MPI_Alltoall(count, 1, MPI_INT, rcount, 1, MPI_INT, comm);
+    for (int r = 1; r < size; r++)
+        rdispl[r] = rdispl[r - 1] + rcount[r - 1];
+    int nrecv = rdispl[size - 1] + rcount[size - 1];
+    int *recv = malloc((nrecv + 1) * sizeof(int));
+    MPI_Alltoallv(cells, count, displ, MPI_INT, recv, rcount, rdispl, MPI_INT, comm);
+
+    // The region with the marks of this process and the ones received, the
+    // process of the last column writes the newlines
+    int w = x1 - x0 + (x1 == G.X), l = y1 - y0;
+    uint8_t *buf = malloc((size_t)w * l + 1);
+    for (int y = y0; y < y1; y++)
+        for (int x = x0; x < x1; x++)
+            buf[(size_t)(y - y0) * w + x - x0] = gridHas(&G, x, y) ? gridMark(&G, x, y) : M_NULL;
+    for (int i = 0; i < nrecv; i += 3)
+    {
+        uint8_t *c = buf + (size_t)(recv[i + 1] - y0) * w + recv[i] - x0;
+        *c = recv[i + 2] > *c ? recv[i + 2] : *c;
+    }
+    for (int y = 0; y < l; y++)
+    {
+        uint8_t *r = buf + (size_t)y * w;
+        for (int x = 0; x < x1 - x0; x++)
+            r[x] = mark_chars[r[x] - M_NULL];
+        if (x1 == G.X)
+            r[w - 1] = '\n';
+    }
+    writeDumpBlock(f, rows, G.X, G.Y, x0, y0, w, l, (char *)buf);
+
+    free(writer);
+    free(count);
+    free(displ);
+    free(fill);
+    free(cells);
+    free(rcount);
+    free(rdispl);
+    free(recv);
+    free(buf);
+    free(region);
+    free(near);
+    MPI_File_close(&f);
 }
 
 void debug(int rank, char *format, ...)
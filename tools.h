@@ -2,6 +2,7 @@
 #define __TOOLS_H__
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -24,14 +25,33 @@ typedef struct
     int x, y;
 } position;
 
+// Rows of the grid are padded to a multiple of GRID_ALIGN bytes so that every
+// row starts on a cache line.
+#define GRID_ALIGN 64
+
 // A grid.
+// Cells are stored row-major in a single contiguous block of bytes: the cell
+// (x,y) lives at index (y - y0) * stride + (x - x0). Use the accessors below
+// rather than indexing the arrays directly.
+// A grid usually stores all its cells (x0 = y0 = 0, LX = X, LY = Y). A block
+// of a grid distributed among processes only stores the cells of the
+// rectangle [x0,x0+LX[ x [y0,y0+LY[.
+// The values of a grid shared by the processes of a node live in the MPI
+// window win (MPI_WIN_NULL otherwise) and must not be modified. The values
+// of a grid read from a file may be mapped from it (mapped > 0).
 typedef struct
 {
     int X, Y;       // dimensions: X and Y
-    int **value;    // cell values: value[i][j], 0<=i<X, 0<=j<Y
-    int **mark;     // cell markings: mark[i][j], 0<=i<X, 0<=j<Y
+    int x0, y0;     // first column and row stored
+    int LX, LY;     // number of columns and rows stored
+    int stride;     // row length in bytes (LX rounded up to GRID_ALIGN)
+    uint8_t *value; // cell values: x0<=x<x0+LX, y0<=y<y0+LY
+    uint8_t *mark;  // cell markings: same layout as value
     position start; // position of the source
     position end;   // position of the destination
+    MPI_Win win;    // shared window of the values, or MPI_WIN_NULL
+    size_t mapped;  // bytes of the mapping of the grid file of the values, or 0
+    uint8_t epoch;  // stamp of the current marks, see clearGridMarks()
 } grid;
 
 // Possible values for the cells of a grid for the .value and .mark fields.
@@ -55,18 +75,87 @@ enum
     M_PATH,  // vertex in the path
 };
 
+// A mark is stored as the epoch of the grid plus its offset from M_NULL, so
+// that clearGridMarks() forgets all of them at once: a byte stamped by
+// another epoch reads as M_NULL, as do the bytes 0 and M_NULL, which are
+// below the first epoch.
+#define MARK_KINDS (M_PATH - M_NULL + 1)
+#define MARK_FIRST_EPOCH 8
+
+// Finalizer of splitmix64: mixes the bits of a counter into a random number.
+static inline uint64_t mix64(uint64_t z)
+{
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Index of cell (x,y) in the value and mark arrays.
+static inline size_t gridIndex(const grid *G, int x, int y)
+{
+    return (size_t)(y - G->y0) * G->stride + (x - G->x0);
+}
+
+// Returns true if cell (x,y) is stored in G.
+static inline bool gridHas(const grid *G, int x, int y)
+{
+    return x >= G->x0 && x < G->x0 + G->LX && y >= G->y0 && y < G->y0 + G->LY;
+}
+
+// Number of bytes of the value (or mark) array.
+static inline size_t gridSize(const grid *G)
+{
+    return (size_t)G->stride * G->LY;
+}
+
+static inline int gridValue(const grid *G, int x, int y)
+{
+    return G->value[gridIndex(G, x, y)];
+}
+
+static inline void setGridValue(grid *G, int x, int y, int v)
+{
+    G->value[gridIndex(G, x, y)] = (uint8_t)v;
+}
+
+static inline int gridMark(const grid *G, int x, int y)
+{
+    uint8_t m = G->mark[gridIndex(G, x, y)] - G->epoch;
+    return m < MARK_KINDS ? M_NULL + m : M_NULL;
+}
+
+static inline void setGridMark(grid *G, int x, int y, int m)
+{
+    G->mark[gridIndex(G, x, y)] = (uint8_t)(G->epoch + m - M_NULL);
+}
+
 // Drawing and grid construction routines. The (0,0) point of the grid is the top left corner.
 // For more details on the functions, see tools.c
 
-void saveGridValueFile(grid G, char *filename); // saves the grid values to a file
-void saveGridMarkFile(grid G, char *filename);  // saves the grid markings to a file
+void saveGridValueFile(grid G, char *filename, MPI_Comm comm); // writes the grid values to a file, collective
+void saveGridMarkFile(grid G, char *filename, MPI_Comm comm);  // writes the merged grid markings to a file, collective
 // void addMarkToGrid(grid G, char *filename); // adds markings to a grid from a file
 
-grid initGridLaby(int, int, int w);             // labyrinth x,y, w = corridor width
-grid initGridPoints(int, int, int t, double p); // pts of texture t with proba p
-grid initGridFile(char *);                      // builds a grid from a file
+grid initGridLaby(int, int, int w, unsigned seed,
+                  MPI_Comm comm, int threads); // labyrinth x,y, w = corridor width, collective
+grid initGridLabyBlock(int, int, int w, unsigned seed, int x0, int y0, int x1, int y1,
+                       int threads); // cells [x0,x1[ x [y0,y1[ of the labyrinth
+grid initGridPoints(int, int, int t, double p, unsigned seed,
+                    MPI_Comm comm, int threads); // pts of texture t with proba p, collective
+grid initGridPointsBlock(int, int, int t, double p, unsigned seed, int x0, int y0, int x1, int y1,
+                         int threads); // cells [x0,x1[ x [y0,y1[ of pts
+grid initGridFile(char *);                      // builds a grid from a grid file, see saveGridFile()
+grid initGridFileBlock(char *, int x0, int y0, int x1, int y1,
+                       MPI_Comm comm);          // cells [x0,x1[ x [y0,y1[ of a grid file, collective
+grid initGridText(char *);                      // builds a grid from the layout of saveGridValueFile()
+bool isGridFile(char *);                        // true if the file is a grid file
+bool gridFileSize(char *, int *X, int *Y);      // dimensions of a grid file, false if it is not one
+bool saveGridFile(grid G, char *, int tile);    // writes a grid file, with tiles of tile cells if tile > 0
+grid shareGrid(grid G, MPI_Comm comm);          // G with values shared by the processes of comm
 position randomPosition(grid, int t);           // random position on texture type t
 void freeGrid(grid);                            // frees the memory allocated by the initGridXXX() functions
+void clearGridMarks(grid *G);                   // sets all the marks of G to M_NULL, in O(1) most of the time
+uint64_t gridHash(const grid *G);               // hash of the values of a whole grid, for the caches
 void debug(int rank, char *format, ...);        // debug function
 
 #endif
@@ -0,0 +1,156 @@
+#include "trace.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRACE_PINGS 16 // round trips measuring the offset of the clock of a process
+
+// Returns the offset to add to MPI_Wtime() of this process to read the
+// clock of process 0 of comm. The ping-pong with process 0 of the shortest
+// round trip is assumed symmetric, its error is half of the round trip.
+static double clockOffset(MPI_Comm comm)
+{
+    int rank, size, *global, found;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    MPI_Comm_get_attr(MPI_COMM_WORLD, MPI_WTIME_IS_GLOBAL, &global, &found);
+    if (found && *global)
+        return 0;
+
+    double offset = 0, best = INFINITY;
+    for (int r = 1; r < size; r++)
+    {
+        for (int i = 0; i < TRACE_PINGS; i++)
+        {
+            if (rank == 0)
+            {
+                MPI_Recv(NULL, 0, MPI_BYTE, r, 0, comm, MPI_STATUS_IGNORE);
+                double t = MPI_Wtime();
+                MPI_Send(&t, 1, MPI_DOUBLE, r, 0, comm);
+            }
+            else if (rank == r)
+            {
+                double t, t0 = MPI_Wtime();
+                MPI_Send(NULL, 0, MPI_BYTE, 0, 0, comm);
+                MPI_Recv(&t, 1, MPI_DOUBLE, 0, 0, comm, MPI_STATUS_IGNORE);
+                double t1 = MPI_Wtime();
+                if (t1 - t0 < best)
+                {
+                    best = t1 - t0;
+                    offset = t - (t0 + t1) / 2;
+                }
+            }
+        }
+    }
+    return offset;
+}
+
+trace trace_create(long capacity, MPI_Comm comm)
+{
+    trace T = malloc(sizeof(struct trace));
+    T->events = malloc(capacity * sizeof(trace_event));
+    if (T->events == NULL)
+    {
+        fprintf(stderr, "Not enough memory for the trace\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    T->capacity = capacity;
+    T->n = 0;
+    MPI_Comm_dup(comm, &T->comm);
+    T->offset = clockOffset(T->comm);
+    T->origin = MPI_Wtime() + T->offset;
+    MPI_Bcast(&T->origin, 1, MPI_DOUBLE, 0, T->comm);
+    return T;
+}
+
+void trace_destroy(trace T)
+{
+    MPI_Comm_free(&T->comm);
+    free(T->events);
+    free(T);
+}
+
+// Microseconds since the origin of T of the time t of this process
+static double traceTime(trace T, double t)
+{
+    return (t + T->offset - T->origin) * 1e6;
+}
+
+// Writes the events of this process to buf, as the elements of the array
+// of the events of the trace, each one preceded by a comma except the very
+// first of the file. Returns the number of characters written.
+static size_t formatEvents(trace T, const char *const *names, int rank, char *buf)
+{
+    char *p = buf;
+    long kept = T->n < T->capacity ? T->n : T->capacity;
+    p += sprintf(p, "%s\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"rank %d\"}}",
+                 rank == 0 ? "" : ",", rank, rank);
+    p += sprintf(p, ",\n{\"name\":\"process_sort_index\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"sort_index\":%d}}", rank,
+                 rank);
+    if (T->n > kept)
+        p += sprintf(p, ",\n{\"name\":\"process_labels\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"labels\":\"%ld events "
+                        "dropped\"}}",
+                     rank, T->n - kept);
+
+    // oldest event first
+    for (long i = T->n - kept; i < T->n; i++)
+    {
+        trace_event *e = &T->events[i % T->capacity];
+        double ts = traceTime(T, e->begin);
+        if (e->end == e->begin)
+            p += sprintf(p, ",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":%d,\"tid\":0,\"ts\":%.3f",
+                         names[e->kind], rank, ts);
+        else
+            p += sprintf(p, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f",
+                         names[e->kind], rank, ts, traceTime(T, e->end) - ts);
+        p += e->arg != 0 ? sprintf(p, ",\"args\":{\"n\":%d}}", e->arg) : sprintf(p, "}");
+    }
+    return p - buf;
+}
+
+bool trace_write(trace T, const char *filename, const char *const *names)
+{
+    int rank, size;
+    MPI_Comm_rank(T->comm, &rank);
+    MPI_Comm_size(T->comm, &size);
+
+    // An event takes less than 128 characters besides its name
+    long kept = T->n < T->capacity ? T->n : T->capacity;
+    size_t longest = 0;
+    for (long i = 0; i < kept; i++)
+        if (strlen(names[T->events[i].kind]) > longest)
+            longest = strlen(names[T->events[i].kind]);
+    char *buf = malloc((kept + 3) * (longest + 128));
+    int ok = buf != NULL;
+    MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_LAND, T->comm);
+    if (!ok)
+    {
+        free(buf);
+        return false;
+    }
+    static const char head[] = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", tail[] = "\n]}\n";
+    long long length = formatEvents(T, names, rank, buf), offset = 0;
+    MPI_Exscan(&length, &offset, 1, MPI_LONG_LONG, MPI_SUM, T->comm);
+    if (rank == 0)
+        offset = 0;
+
+    // The processes write their events one after the other, after the head
+    MPI_File f;
+    ok = MPI_File_open(T->comm, filename, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &f) == MPI_SUCCESS;
+    if (ok)
+    {
+        MPI_File_set_size(f, 0);
+        MPI_Offset at = sizeof(head) - 1 + offset;
+        ok = MPI_File_write_at_all(f, at, buf, length, MPI_CHAR, MPI_STATUS_IGNORE) == MPI_SUCCESS;
+        if (rank == 0)
+            ok &= MPI_File_write_at(f, 0, head, sizeof(head) - 1, MPI_CHAR, MPI_STATUS_IGNORE) == MPI_SUCCESS;
+        if (rank == size - 1)
+            ok &= MPI_File_write_at(f, at + length, tail, sizeof(tail) - 1, MPI_CHAR, MPI_STATUS_IGNORE) ==
+                  MPI_SUCCESS;
+        MPI_File_close(&f);
+    }
+    free(buf);
+    MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_LAND, T->comm);
+    return ok;
+}
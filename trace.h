@@ -0,0 +1,65 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <mpi.h>
+
+// Event of a trace: a span of kind from begin to end (MPI_Wtime() of the
+// process), or an instant event if begin == end. arg is a number attached
+// to the event, printed if not 0.
+typedef struct
+{
+    double begin, end;
+    int kind;
+    int arg;
+} trace_event;
+
+// Timeline of the events of a process, kept in a ring buffer.
+//
+//  events   = ring buffer of capacity events
+//  n        = number of events recorded, the last capacity ones are kept
+//  offset   = offset to add to MPI_Wtime() of this process to read the
+//             clock of process 0 of comm
+//  origin   = clock of process 0 when the trace was created, time 0 of the
+//             trace
+//  comm     = communicator of the processes tracing, duplicated
+//
+// Recording an event is a copy into the buffer: the buffer never grows,
+// the oldest events are overwritten, so tracing costs no allocation and
+// no communication until the trace is written.
+typedef struct trace
+{
+    trace_event *events;
+    long capacity, n;
+    double offset, origin;
+    MPI_Comm comm;
+} *trace;
+
+// Creates the traces of the processes of comm, keeping the last capacity
+// events of every one, and aligns their clocks on the clock of process 0.
+// Collective.
+trace trace_create(long capacity, MPI_Comm comm);
+
+// Frees the trace T. Collective.
+void trace_destroy(trace T);
+
+// Writes the events of all the processes to filename, in the Chrome trace
+// format read by chrome://tracing and Perfetto: one process (pid) per rank,
+// the events named names[kind]. Returns false if the file cannot be
+// written. Collective.
+bool trace_write(trace T, const char *filename, const char *const *names);
+
+// Records the span of kind from begin to end.
+static inline void trace_span(trace T, int kind, double begin, double end, int arg)
+{
+    T->events[T->n++ % T->capacity] = (trace_event){begin, end, kind, arg};
+}
+
+// Records an instant event of kind now.
+static inline void trace_instant(trace T, int kind, int arg)
+{
+    double now = MPI_Wtime();
+    trace_span(T, kind, now, now, arg);
+}
+
+#endif